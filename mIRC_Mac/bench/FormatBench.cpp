@@ -0,0 +1,141 @@
+// mIRC formatting: decode cost per line for plain, lightly formatted and
+// colour-heavy chatter, how many runs that leaves per line and what they
+// take in scrollback, and what decoding adds to Scrollback::Append.
+//
+//   ./mIRC_FormatBench [lines]
+//
+// One JSON object per line on stdout.
+
+#include "../src/IRCFormat.h"
+#include "../src/Scrollback.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const char* const kWords[] = {
+    "the", "a", "to", "is", "it", "that", "and", "of", "you", "for", "on", "with", "have", "but",
+    "anyone", "know", "how", "kernel", "patch", "build", "works", "here", "again", "server", "lag",
+    "mac", "system", "seven", "powerbook", "ethernet", "driver", "thanks", "lol", "yeah", "nope",
+};
+static const int kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+enum LineKind { kPlain, kLight, kRainbow };
+
+// A chat line of 8-17 words. kLight bolds or colours a word now and then,
+// the way people do by hand; kRainbow colours every character, the way
+// scripts do.
+static void MakeLine(long i, LineKind kind, std::string& line) {
+    char nick[16];
+    std::snprintf(nick, sizeof(nick), "<user%ld> ", i % 300);
+    line.assign(nick);
+    unsigned seed = (unsigned)i * 2654435761u;
+    int words = 8 + (int)(seed % 10);
+    std::string text;
+    for (int w = 0; w < words; w++) {
+        seed = seed * 1103515245u + 12345u;
+        if (w) text += ' ';
+        const char* word = kWords[(seed >> 16) % kWordCount];
+        if (kind == kLight && (seed >> 8) % 7 == 0) {
+            text += "\x02";
+            text += word;
+            text += "\x02";
+        } else if (kind == kLight && (seed >> 8) % 11 == 0) {
+            char color[8];
+            std::snprintf(color, sizeof(color), "\x03%u", (seed >> 4) % 16);
+            text += color;
+            text += word;
+            text += "\x03";
+        } else {
+            text += word;
+        }
+    }
+    if (kind != kRainbow) {
+        line += text;
+        return;
+    }
+    for (size_t c = 0; c < text.size(); c++) {
+        char color[8];
+        std::snprintf(color, sizeof(color), "\x03%02u,01", (unsigned)((c + i) % 15) + 1);
+        line += color;
+        line += text[c];
+    }
+    line += "\x0F";
+}
+
+int main(int argc, char** argv) {
+    long lines = (argc > 1) ? std::atol(argv[1]) : 200000;
+    if (lines <= 0) return 2;
+
+    static const char* const kKindNames[] = { "plain", "light", "rainbow" };
+    std::vector<std::string> generated;
+    std::string line, work;
+    StyleRun runs[kMaxStyleRuns];
+    for (int kind = kPlain; kind <= kRainbow; kind++) {
+        generated.clear();
+        size_t rawBytes = 0;
+        for (long i = 0; i < lines; i++) {
+            MakeLine(i, (LineKind)kind, line);
+            rawBytes += line.size();
+            generated.push_back(line);
+        }
+
+        // Decode alone; the copy into 'work' is timed separately and taken off
+        size_t plainBytes = 0, totalRuns = 0;
+        BenchClock::time_point t0 = BenchClock::now();
+        for (long i = 0; i < lines; i++) work.assign(generated[i]);
+        double copyNs = std::chrono::duration<double, std::nano>(BenchClock::now() - t0).count();
+        t0 = BenchClock::now();
+        for (long i = 0; i < lines; i++) {
+            work.assign(generated[i]);
+            size_t runCount;
+            plainBytes += DecodeIRCFormatting(&work[0], work.size(), runs, kMaxStyleRuns, runCount);
+            totalRuns += runCount;
+        }
+        double decodeNs = std::chrono::duration<double, std::nano>(BenchClock::now() - t0).count() - copyNs;
+        if (decodeNs < 0) decodeNs = 0;
+
+        // Scrollback with the decode in Append, against the plain text
+        // appended with the codes already gone
+        size_t cap = (size_t)lines * 64 + 65536;
+        ScrollbackPool pool(cap * 2 + 65536);
+        Scrollback styled(pool, cap);
+        t0 = BenchClock::now();
+        for (long i = 0; i < lines; i++) styled.Append(generated[i].data(), generated[i].size());
+        double styledNs = std::chrono::duration<double, std::nano>(BenchClock::now() - t0).count();
+        uint32_t kept = styled.EndLine() - styled.FirstLine();
+
+        std::vector<std::string> stripped;
+        stripped.reserve(kept);
+        size_t storedRuns = 0, storedBytes = 0;
+        for (uint32_t n = styled.FirstLine(); n < styled.EndLine(); n++) {
+            const char* text;
+            size_t length;
+            const StyleRun* lineRuns;
+            size_t runCount;
+            styled.GetLine(n, text, length, lineRuns, runCount);
+            stripped.push_back(std::string(text, length));
+            storedRuns += runCount;
+            storedBytes += length;
+        }
+        ScrollbackPool plainPool(cap * 2 + 65536);
+        Scrollback plain(plainPool, cap);
+        t0 = BenchClock::now();
+        for (size_t i = 0; i < stripped.size(); i++) plain.Append(stripped[i].data(), stripped[i].size());
+        double plainNs = std::chrono::duration<double, std::nano>(BenchClock::now() - t0).count();
+
+        std::printf("{\"case\":\"%s\",\"lines\":%ld,\"raw_bytes_per_line\":%.1f,\"plain_bytes_per_line\":%.1f,"
+                    "\"decode_ns_per_line\":%.1f,\"decode_mb_per_sec\":%.0f,\"runs_per_line\":%.2f,"
+                    "\"run_bytes_pct\":%.2f,\"append_ns_per_line\":%.1f,\"append_plain_ns_per_line\":%.1f}\n",
+                    kKindNames[kind], lines, (double)rawBytes / lines, (double)plainBytes / lines,
+                    decodeNs / lines, rawBytes / 1048576.0 / (decodeNs / 1e9 + 1e-12), (double)totalRuns / lines,
+                    100.0 * storedRuns * sizeof(StyleRun) / (storedBytes + 1e-9),
+                    styledNs / lines, plainNs / (stripped.size() + 1e-9));
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Writes a long multi-day log for one channel through LogWriter (with its
+// clock overridden), then reads it back the way the history pager does:
+// open, page up from the live end, seek to dates, walk it all. The
+// point is that none of these should grow with the size of the log.
+//
+//   ./mIRC_HistoryBench [megabytes] [days]
+//
+// Built twice: mIRC_HistoryBench maps the day files, mIRC_HistoryBenchPaged
+// goes through the page cache like the Mac. One JSON object on stdout.
+
+#include "../src/History.h"
+#include "../src/LogWriter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+
+static const int kLinesPerPage = 40;
+static const int kPages = 2000;
+static const int kSeeks = 2000;
+
+static void RemoveDirectory(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        unlink((path + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+static int StampMinute(std::string_view line) {
+    if (line.size() < 7 || line[0] != '[') return -1;
+    return ((line[1] - '0') * 10 + (line[2] - '0')) * 60 + (line[4] - '0') * 10 + (line[5] - '0');
+}
+
+int main(int argc, char** argv) {
+    typedef std::chrono::steady_clock Clock;
+    long megabytes = (argc > 1) ? std::atol(argv[1]) : 100;
+    int days = (argc > 2) ? std::atoi(argv[2]) : 14;
+    if (megabytes <= 0 || days <= 0 || days > 28) return 2;
+
+    char base[] = "/tmp/mirc_historybench_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    std::string directory = std::string(base) + "/logs";
+
+    // Lines are ~90 bytes; spread them evenly over the days
+    long lines = megabytes * 1024 * 1024 / 90;
+    long linesPerDay = lines / days + 1;
+    std::string fileName;
+    unsigned long bytes = 0;
+    Clock::time_point t0 = Clock::now();
+    {
+        LogWriter writer;
+        writer.SetDirectory(directory);
+        int handle = writer.Open("#history");
+        fileName.assign(writer.FileName(handle));
+
+        char nick[16];
+        char text[128];
+        for (long i = 0; i < lines; i++) {
+            long second = (i % linesPerDay) * 86400 / linesPerDay;
+            ClockDate date = { 2024, 3, (int)(i / linesPerDay) + 1, (int)(second / 3600),
+                               (int)(second / 60 % 60), (int)(second % 60) };
+            writer.SetClockOverride(&date);
+            std::snprintf(nick, sizeof(nick), "user%ld", i % 500);
+            std::snprintf(text, sizeof(text), "line %ld, padded out to about the length of ordinary chatter", i);
+            writer.Append(handle, { "<", nick, "> ", text });
+            if ((i + 1) % 50 == 0) writer.Poll(true);
+        }
+        writer.Close(handle);
+        bytes = writer.GetStats().bytesWritten;
+    }
+    double writeSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // Open: against a missing history, then the real one
+    HistoryReader empty;
+    t0 = Clock::now();
+    empty.Open(directory, "#nothing");
+    double emptyOpenUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+
+    HistoryReader reader;
+    t0 = Clock::now();
+    reader.Open(directory, fileName);
+    HistoryPos pos = reader.End();
+    std::string_view line;
+    for (int n = 0; n < kLinesPerPage; n++) reader.PrevLine(pos, line);
+    double openUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+
+    // Page up from the live end
+    double maxPageUs = 0;
+    t0 = Clock::now();
+    for (int p = 0; p < kPages; p++) {
+        Clock::time_point start = Clock::now();
+        for (int n = 0; n < kLinesPerPage; n++) reader.PrevLine(pos, line);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (us > maxPageUs) maxPageUs = us;
+    }
+    double pageUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / kPages;
+
+    // Seeks to random times; each result must be the first line at or
+    // after the wanted minute
+    srand(1);
+    long wrongSeeks = 0;
+    double maxSeekUs = 0;
+    t0 = Clock::now();
+    for (int s = 0; s < kSeeks; s++) {
+        int day = 1 + rand() % days;
+        uint32_t second = (uint32_t)(rand() % 86340);
+        Clock::time_point start = Clock::now();
+        HistoryPos found = reader.Seek(20240300 + day, second);
+        HistoryPos next = found;
+        bool got = reader.NextLine(next, line);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (us > maxSeekUs) maxSeekUs = us;
+
+        if (got && found.segment == day - 1 && StampMinute(line) < (int)(second / 60)) wrongSeeks++;
+        HistoryPos prev = found;
+        if (found.segment == day - 1 && found.offset > 0 && reader.PrevLine(prev, line) &&
+            StampMinute(line) >= (int)(second / 60)) {
+            wrongSeeks++;
+        }
+    }
+    double seekUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / kSeeks;
+
+    // Walk everything backwards once: every line should come back
+    long walked = 0;
+    pos = reader.End();
+    t0 = Clock::now();
+    while (reader.PrevLine(pos, line)) walked++;
+    double walkSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    double megabytesWritten = bytes / 1048576.0;
+    std::printf("{\"megabytes\":%.1f,\"days\":%d,\"segments\":%d,\"lines\":%ld,\"write_sec\":%.2f,"
+                "\"open_empty_us\":%.1f,\"open_first_page_us\":%.1f,\"page_us\":%.1f,\"max_page_us\":%.1f,"
+                "\"seek_us\":%.1f,\"max_seek_us\":%.1f,\"wrong_seeks\":%ld,\"walked_lines\":%ld,"
+                "\"walk_mb_per_sec\":%.0f,\"page_reads\":%lu,\"cache_hits\":%lu,\"mapped_mb\":%.1f}\n",
+                megabytesWritten, days, reader.SegmentCount(), lines, writeSeconds, emptyOpenUs, openUs, pageUs,
+                maxPageUs, seekUs, maxSeekUs, wrongSeeks, walked, megabytesWritten / walkSeconds,
+                reader.PageReads(), reader.CacheHits(), reader.MappedBytes() / 1048576.0);
+
+    reader.Close();
+    RemoveDirectory(directory);
+    rmdir(base);
+    return (wrongSeeks || walked != lines) ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Drives LogWriter the way the event loop does: bursts of lines spread over
+// several channels, a busy Poll() after every burst and an idle one every
+// so often. Reports logging throughput and the longest single stall a
+// Poll() or Append() caused.
+//
+//   ./mIRC_LogBench [lines] [channels]
+//
+// Files go to a temporary directory that is removed afterwards. One JSON
+// object is printed on stdout.
+
+#include "../src/LogWriter.h"
+#include "../src/Clock.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+
+static const int kLinesPerPass = 50;  // roughly one read budget's worth
+static const int kPassesPerIdle = 20;
+
+static void RemoveDirectory(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        unlink((path + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+int main(int argc, char** argv) {
+    typedef std::chrono::steady_clock Clock;
+    long lines = (argc > 1) ? std::atol(argv[1]) : 500000;
+    int channels = (argc > 2) ? std::atoi(argv[2]) : 8;
+    if (lines <= 0 || channels <= 0) return 2;
+
+    char base[] = "/tmp/mirc_logbench_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    std::string directory = std::string(base) + "/logs";
+
+    uint32_t maxAppendMicros = 0;
+    Clock::time_point t0 = Clock::now();
+    LogWriter::Stats stats;
+    {
+        LogWriter writer;
+        writer.SetDirectory(directory);
+        int* handles = new int[channels];
+        for (int c = 0; c < channels; c++) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "#channel%d", c);
+            handles[c] = writer.Open(name);
+        }
+
+        char nick[16];
+        char text[96];
+        long passes = 0;
+        for (long i = 0; i < lines; i++) {
+            std::snprintf(nick, sizeof(nick), "user%ld", i % 500);
+            std::snprintf(text, sizeof(text), "message %ld with a typical amount of chatter in it", i);
+            uint32_t start = ClockMicros();
+            writer.Append(handles[i % channels], { "<", nick, "> ", text });
+            uint32_t micros = ClockMicros() - start;
+            if (micros > maxAppendMicros) maxAppendMicros = micros;
+
+            if ((i + 1) % kLinesPerPass == 0) {
+                passes++;
+                writer.Poll(passes % kPassesPerIdle == 0);
+            }
+        }
+        writer.FlushAll();
+        stats = writer.GetStats();
+        for (int c = 0; c < channels; c++) writer.Close(handles[c]);
+        delete[] handles;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    RemoveDirectory(directory);
+    rmdir(base);
+
+    std::printf("{\"lines\":%ld,\"channels\":%d,\"lines_per_sec\":%.0f,\"ns_per_line\":%.1f,"
+                "\"blocks\":%lu,\"bytes\":%lu,\"avg_block_bytes\":%lu,\"max_stall_us\":%lu,"
+                "\"max_append_us\":%lu,\"forced_flushes\":%lu,\"lost_lines\":%lu}\n",
+                lines, channels, lines / seconds, seconds * 1e9 / lines,
+                stats.blocksWritten, stats.bytesWritten,
+                stats.blocksWritten ? stats.bytesWritten / stats.blocksWritten : 0UL,
+                (unsigned long)stats.maxStallMicros, (unsigned long)maxAppendMicros,
+                stats.forcedFlushes, stats.writeErrors);
+    return stats.writeErrors ? 1 : 0;
+}
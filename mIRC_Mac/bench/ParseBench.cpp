@@ -0,0 +1,120 @@
+// Microbenchmark: the old stringstream ParseLine against ParseIRCLine.
+// Reports lines/sec and heap allocations per line for each.
+//
+//   ./mIRC_ParseBench [iterations]
+
+#include "../src/IRCParser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static unsigned long gAllocCount = 0;
+
+void* operator new(std::size_t size) {
+    gAllocCount++;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Verbatim copy of the pre-IRCParser code path, kept for comparison
+struct LegacyMessage {
+    std::string prefix;
+    std::string command;
+    std::vector<std::string> params;
+};
+
+static bool LegacyParse(const std::string& line, LegacyMessage& msg) {
+    if (line.empty()) return false;
+
+    std::stringstream ss(line);
+    std::string segment;
+
+    if (line[0] == ':') {
+        ss >> segment;
+        msg.prefix = segment.substr(1);
+    }
+
+    ss >> msg.command;
+
+    while (ss >> segment) {
+        if (segment[0] == ':') {
+            std::string trailing;
+            getline(ss, trailing);
+            msg.params.push_back(segment.substr(1) + trailing);
+            break;
+        } else {
+            msg.params.push_back(segment);
+        }
+    }
+    return true;
+}
+
+static const char* kSampleLines[] = {
+    ":nick!user@host.example.net PRIVMSG #macintosh :has anyone got a SCSI2SD working on an SE/30?",
+    ":alice!~a@198.51.100.7 PRIVMSG #retro :lol",
+    ":bob!bob@gateway/web/irccloud.com/x-abcdef PRIVMSG #macintosh :System 7.1 with MacTCP 2.0.6 here",
+    "PING :irc.libera.chat",
+    ":carol!c@host JOIN #macintosh",
+    ":dave!d@host PART #macintosh :Leaving",
+    ":irc.libera.chat 353 mIRC_SE30 = #macintosh :@ChanServ +alice bob carol dave erin frank grace heidi",
+    ":irc.libera.chat 372 mIRC_SE30 :- Welcome to Libera Chat, the IRC network for free & open-source software",
+    ":erin!e@host QUIT :Ping timeout: 260 seconds",
+    ":frank!f@host NOTICE mIRC_SE30 :\x01VERSION\x01",
+    "@time=2024-03-01T12:34:56.789Z;msgid=AB12cd34 :grace!g@host PRIVMSG #macintosh :tagged by server-time",
+    "@batch=s1;time=2024-03-01T12:35:00.000Z :heidi!h@host QUIT :hub.example.net leaf.example.net",
+};
+static const int kSampleCount = sizeof(kSampleLines) / sizeof(kSampleLines[0]);
+
+int main(int argc, char** argv) {
+    long iterations = (argc > 1) ? std::atol(argv[1]) : 200000;
+    if (iterations <= 0) iterations = 1;
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < kSampleCount; i++) lines.push_back(kSampleLines[i]);
+    const long total = iterations * kSampleCount;
+
+    typedef std::chrono::steady_clock Clock;
+    size_t checksum = 0;
+
+    // Legacy
+    unsigned long allocStart = gAllocCount;
+    Clock::time_point t0 = Clock::now();
+    for (long i = 0; i < iterations; i++) {
+        for (int j = 0; j < kSampleCount; j++) {
+            LegacyMessage msg;
+            LegacyParse(lines[j], msg);
+            checksum += msg.params.size();
+        }
+    }
+    double legacySecs = std::chrono::duration<double>(Clock::now() - t0).count();
+    unsigned long legacyAllocs = gAllocCount - allocStart;
+
+    // View parser
+    allocStart = gAllocCount;
+    t0 = Clock::now();
+    for (long i = 0; i < iterations; i++) {
+        for (int j = 0; j < kSampleCount; j++) {
+            IRCMessageView msg;
+            ParseIRCLine(lines[j].data(), lines[j].size(), msg);
+            checksum += msg.paramCount;
+        }
+    }
+    double viewSecs = std::chrono::duration<double>(Clock::now() - t0).count();
+    unsigned long viewAllocs = gAllocCount - allocStart;
+
+    std::printf("%-10s %14s %10s %14s\n", "parser", "lines/sec", "ns/line", "allocs/line");
+    std::printf("%-10s %14.0f %10.1f %14.2f\n", "legacy",
+                total / legacySecs, legacySecs * 1e9 / total, (double)legacyAllocs / total);
+    std::printf("%-10s %14.0f %10.1f %14.2f\n", "view",
+                total / viewSecs, viewSecs * 1e9 / total, (double)viewAllocs / total);
+    std::printf("(checksum %zu)\n", checksum);
+    return 0;
+}
@@ -0,0 +1,425 @@
+// Replays IRC traffic through IRCClient via a ByteSource and reports
+// throughput, per-line cost, heap allocations and peak heap use. Built-in
+// scenarios are generated in memory; recorded captures (raw bytes as the
+// server sent them) can be added on the command line.
+//
+//   ./mIRC_Bench [--iterations N] [--baseline results.jsonl] [capture ...]
+//
+// One JSON object per scenario is printed on stdout. With --baseline, each
+// scenario is compared with the same-named line of an earlier run and the
+// exit status is 1 if any got more than 10% slower per line.
+
+#include "../src/IRCClient.h"
+#include "../src/IRCParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Every allocation carries its size in a header so live bytes can be
+// tracked exactly
+static const size_t kHeaderSize = alignof(std::max_align_t) > sizeof(size_t)
+                                      ? alignof(std::max_align_t) : sizeof(size_t);
+static unsigned long gAllocCount = 0;
+static size_t gLiveBytes = 0;
+static size_t gPeakBytes = 0;
+
+void* operator new(std::size_t size) {
+    char* p = (char*)std::malloc(size + kHeaderSize);
+    if (!p) throw std::bad_alloc();
+    *(size_t*)p = size;
+    gAllocCount++;
+    gLiveBytes += size;
+    if (gLiveBytes > gPeakBytes) gPeakBytes = gLiveBytes;
+    return p + kHeaderSize;
+}
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    char* base = (char*)p - kHeaderSize;
+    gLiveBytes -= *(size_t*)base;
+    std::free(base);
+}
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+static const double kRegressionThreshold = 0.10;
+static const int kChunkSize = 1460; // one Ethernet-sized TCP segment per read
+
+// Hands the capture to the client a segment at a time, then reports
+// "would block" so Update() returns once everything has been consumed.
+class ReplaySource : public ByteSource {
+public:
+    explicit ReplaySource(const std::string& data) : data(data), pos(0), bytesWritten(0) {}
+
+    int Read(char* buf, int maxlen) override {
+        if (pos >= data.size()) return -1;
+        size_t n = std::min(data.size() - pos, (size_t)std::min(maxlen, kChunkSize));
+        memcpy(buf, data.data() + pos, n);
+        pos += n;
+        return (int)n;
+    }
+
+    int Write(const char*, size_t length) override {
+        bytesWritten += length;
+        return (int)length;
+    }
+
+    bool Exhausted() const { return pos >= data.size(); }
+    size_t BytesWritten() const { return bytesWritten; }
+
+private:
+    const std::string& data;
+    size_t pos;
+    size_t bytesWritten;
+};
+
+struct Scenario {
+    std::string name;
+    std::string data;
+};
+
+// Deterministic so runs are comparable
+static uint32_t gSeed = 12345;
+static uint32_t NextRandom() {
+    gSeed = gSeed * 1103515245u + 12345u;
+    return gSeed >> 8;
+}
+
+static std::string Nick(unsigned i) {
+    static const char* kStems[] = { "alice", "bob", "carol", "dave", "erin", "frank", "grace", "heidi" };
+    return std::string(kStems[i % 8]) + std::to_string(i);
+}
+
+static const char* kWelcome = ":irc.example.net 001 benchnick :Welcome to the bench network\r\n";
+
+static std::string BusyChannel() {
+    static const char* kTexts[] = {
+        "has anyone got a SCSI2SD working on an SE/30?",
+        "lol",
+        "System 7.1 with MacTCP 2.0.6 here, works fine once you set the MTU",
+        "brb",
+        "the PDS slot is the interesting part of that board, it talks straight to the 68030 bus",
+    };
+    std::string s = kWelcome;
+    s += ":benchnick!b@host JOIN #macintosh\r\n";
+    s += ":benchnick!b@host JOIN #retro\r\n";
+    for (unsigned i = 0; i < 20000; i++) {
+        unsigned r = NextRandom();
+        std::string who = ":" + Nick(r % 300) + "!u@host-" + std::to_string(r % 97) + ".example.org ";
+        const char* chan = (r & 1) ? "#macintosh" : "#retro";
+        if (i % 500 == 499) {
+            s += "PING :irc.example.net\r\n";
+        } else if (r % 50 == 0) {
+            s += who + "JOIN " + chan + "\r\n";
+        } else if (r % 50 == 1) {
+            s += who + "PART " + chan + " :Leaving\r\n";
+        } else {
+            s += who + "PRIVMSG " + chan + " :" + kTexts[r % 5] + "\r\n";
+        }
+    }
+    return s;
+}
+
+static std::string Netsplit() {
+    std::string s = kWelcome;
+    s += ":benchnick!b@host JOIN #macintosh\r\n";
+    for (unsigned round = 0; round < 4; round++) {
+        for (unsigned i = 0; i < 2500; i++) {
+            s += ":" + Nick(i) + "!u@host.example.org QUIT :hub.example.net leaf" + std::to_string(round) + ".example.net\r\n";
+        }
+        for (unsigned i = 0; i < 2500; i++) {
+            s += ":" + Nick(i) + "!u@host.example.org JOIN #macintosh\r\n";
+        }
+    }
+    return s;
+}
+
+// The same split as a server with the batch capability sends it: each
+// half is one netsplit/netjoin batch, every line carrying its tags
+static std::string NetsplitBatched() {
+    std::string s = kWelcome;
+    s += ":benchnick!b@host JOIN #macintosh\r\n";
+    for (unsigned round = 0; round < 4; round++) {
+        std::string leaf = "leaf" + std::to_string(round) + ".example.net";
+        std::string tags = "@time=2024-03-01T12:0" + std::to_string(round) + ":00.000Z;batch=";
+        s += ":irc.example.net BATCH +s" + std::to_string(round) + " netsplit hub.example.net " + leaf + "\r\n";
+        for (unsigned i = 0; i < 2500; i++) {
+            s += tags + "s" + std::to_string(round) + ";msgid=q" + std::to_string(i) + " :" + Nick(i) +
+                 "!u@host.example.org QUIT :hub.example.net " + leaf + "\r\n";
+        }
+        s += ":irc.example.net BATCH -s" + std::to_string(round) + "\r\n";
+        s += ":irc.example.net BATCH +j" + std::to_string(round) + " netjoin hub.example.net " + leaf + "\r\n";
+        for (unsigned i = 0; i < 2500; i++) {
+            s += tags + "j" + std::to_string(round) + ";msgid=j" + std::to_string(i) + " :" + Nick(i) +
+                 "!u@host.example.org JOIN #macintosh\r\n";
+        }
+        s += ":irc.example.net BATCH -j" + std::to_string(round) + "\r\n";
+    }
+    return s;
+}
+
+static std::string Names5k() {
+    std::string s = kWelcome;
+    s += ":benchnick!b@host JOIN #bigchannel\r\n";
+    std::string line;
+    for (unsigned i = 0; i < 5000; i++) {
+        std::string nick = Nick(i);
+        if (i % 40 == 0) nick = "@" + nick;
+        else if (i % 15 == 0) nick = "+" + nick;
+        if (!line.empty() && line.size() + nick.size() > 400) {
+            s += ":irc.example.net 353 benchnick = #bigchannel :" + line + "\r\n";
+            line.clear();
+        }
+        if (!line.empty()) line += ' ';
+        line += nick;
+    }
+    s += ":irc.example.net 353 benchnick = #bigchannel :" + line + "\r\n";
+    s += ":irc.example.net 366 benchnick #bigchannel :End of /NAMES list.\r\n";
+    return s;
+}
+
+static std::string LongMotd() {
+    std::string s = kWelcome;
+    s += ":irc.example.net 375 benchnick :- irc.example.net Message of the Day -\r\n";
+    for (unsigned i = 0; i < 3000; i++) {
+        s += ":irc.example.net 372 benchnick :- " + std::to_string(i) +
+             " Please read the network policy before connecting bots or scripts.\r\n";
+    }
+    s += ":irc.example.net 376 benchnick :End of /MOTD command.\r\n";
+    return s;
+}
+
+static size_t CountLines(const std::string& data) {
+    return (size_t)std::count(data.begin(), data.end(), '\n');
+}
+
+// Parse only: framing by hand, no client
+static double ParseSeconds(const std::string& data, size_t& checksum) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+    const char* p = data.data();
+    const char* end = p + data.size();
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        size_t len = eol - p;
+        if (len && p[len - 1] == '\r') len--;
+        IRCMessageView msg;
+        if (ParseIRCLine(p, len, msg)) checksum += msg.paramCount;
+        p = eol + 1;
+    }
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+struct RunResult {
+    double seconds;
+    unsigned long allocs;
+    size_t peakBytes;
+    unsigned long linesDispatched;
+    unsigned long events;
+    size_t bytesWritten;
+    size_t interned;           // InternTable entries at the end of the run
+    double internHitPercent;
+    size_t arenaPeak;          // LineArena high-water mark, bytes
+    unsigned long arenaOverflows;
+    size_t nameSlabBytes;
+    unsigned long nameHeapFallbacks;
+};
+
+// Touches every view so delivery cannot be optimised away
+struct BenchSink {
+    size_t checksum;
+    unsigned long events;  // callbacks, i.e. what a UI would have to draw
+
+    BenchSink() : checksum(0), events(0) {}
+    void OnIRCLog(std::string_view s) { events++; checksum += s.size(); }
+    void OnIRCMessage(IRCTarget c, std::string_view u, std::string_view m, const IRCTags& t) {
+        events++;
+        checksum += c.id + c.name.size() + u.size() + m.size() + t.time.size() + t.msgid.size();
+    }
+    void OnIRCJoin(IRCTarget c, std::string_view n, bool) { events++; checksum += c.id + c.name.size() + n.size(); }
+    void OnIRCPart(IRCTarget c, std::string_view n, std::string_view r, bool) {
+        events++;
+        checksum += c.id + c.name.size() + n.size() + r.size();
+    }
+    void OnIRCQuit(IRCTarget c, std::string_view n, std::string_view r) {
+        events++;
+        checksum += c.id + c.name.size() + n.size() + r.size();
+    }
+    void OnIRCNick(IRCTarget c, std::string_view o, std::string_view n, bool) {
+        events++;
+        checksum += c.id + c.name.size() + o.size() + n.size();
+    }
+    void OnIRCNames(IRCTarget c) { events++; checksum += c.id + c.name.size(); }
+    void OnIRCBatchStart(std::string_view type, IRCTarget c) { events++; checksum += type.size() + c.name.size(); }
+    void OnIRCBatchEnd(std::string_view type, IRCTarget c) { events++; checksum += type.size() + c.name.size(); }
+    void OnIRCNetsplit(IRCTarget c, std::string_view servers, uint32_t count, bool) {
+        events++;
+        checksum += c.id + servers.size() + count;
+    }
+};
+
+// Full path: framing, parse, dispatch and replies
+static RunResult ReplayOnce(const std::string& data) {
+    typedef std::chrono::steady_clock Clock;
+    RunResult r;
+
+    ReplaySource source(data); // outlives the client, which sends QUIT on destruction
+    IRCClient client;
+    IRCClient::ReadBudget budget = { 1 << 20, 1u << 20, 0xFFFFFFFFu };
+    client.SetReadBudget(budget);
+    BenchSink sink;
+
+    client.SetByteSource(&source);
+    client.Connect("bench", 6667, "benchnick", "bench", "Replay bench");
+
+    unsigned long allocStart = gAllocCount;
+    size_t liveStart = gLiveBytes;
+    gPeakBytes = gLiveBytes;
+    Clock::time_point t0 = Clock::now();
+    do {
+        client.Update(sink);
+    } while ((!source.Exhausted() || client.HasPendingInput()) &&
+             client.GetState() != IRCClient::State::Disconnected);
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.allocs = gAllocCount - allocStart;
+    r.peakBytes = gPeakBytes - liveStart;
+    r.linesDispatched = client.GetReadStats().totalLines;
+    r.events = sink.events;
+    r.bytesWritten = source.BytesWritten();
+    const InternTable& interns = client.GetInterns();
+    r.interned = interns.Size();
+    r.internHitPercent = interns.Lookups() ? 100.0 * interns.Hits() / interns.Lookups() : 0.0;
+    r.arenaPeak = client.GetLineArena().Peak();
+    r.arenaOverflows = client.GetLineArena().OverflowAllocs();
+    r.nameSlabBytes = client.GetNamePool().SlabBytes();
+    r.nameHeapFallbacks = client.GetNamePool().HeapFallbacks();
+    return r;
+}
+
+// Pulls "key":number out of one JSON line written by this program
+static bool JsonNumber(const std::string& line, const char* key, double& value) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t at = line.find(pattern);
+    if (at == std::string::npos) return false;
+    value = std::atof(line.c_str() + at + pattern.size());
+    return true;
+}
+
+static bool JsonString(const std::string& line, const char* key, std::string& value) {
+    std::string pattern = std::string("\"") + key + "\":\"";
+    size_t at = line.find(pattern);
+    if (at == std::string::npos) return false;
+    at += pattern.size();
+    size_t close = line.find('"', at);
+    if (close == std::string::npos) return false;
+    value = line.substr(at, close - at);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 5;
+    const char* baselinePath = nullptr;
+    std::vector<Scenario> scenarios;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else {
+            std::ifstream in(argv[i], std::ios::binary);
+            if (!in) {
+                std::fprintf(stderr, "cannot read capture %s\n", argv[i]);
+                return 2;
+            }
+            std::stringstream ss;
+            ss << in.rdbuf();
+            const char* slash = std::strrchr(argv[i], '/');
+            scenarios.push_back({ slash ? slash + 1 : argv[i], ss.str() });
+        }
+    }
+
+    if (scenarios.empty()) {
+        scenarios.push_back({ "busy_channel", BusyChannel() });
+        scenarios.push_back({ "netsplit", Netsplit() });
+        scenarios.push_back({ "netsplit_batched", NetsplitBatched() });
+        scenarios.push_back({ "names_5k", Names5k() });
+        scenarios.push_back({ "long_motd", LongMotd() });
+    }
+
+    std::vector<std::string> results;
+    for (size_t s = 0; s < scenarios.size(); s++) {
+        const Scenario& sc = scenarios[s];
+        size_t lines = CountLines(sc.data);
+        if (lines == 0) continue;
+
+        // Best of N for timing; allocation figures are the same every run
+        size_t checksum = 0;
+        double parseBest = 1e30, fullBest = 1e30;
+        RunResult run = {};
+        for (int i = 0; i < iterations; i++) {
+            parseBest = std::min(parseBest, ParseSeconds(sc.data, checksum));
+            run = ReplayOnce(sc.data);
+            fullBest = std::min(fullBest, run.seconds);
+        }
+
+        double nsPerLine = fullBest * 1e9 / lines;
+        double parseNs = parseBest * 1e9 / lines;
+        double dispatchNs = std::max(0.0, nsPerLine - parseNs);
+
+        char json[768];
+        std::snprintf(json, sizeof(json),
+                      "{\"scenario\":\"%s\",\"lines\":%zu,\"bytes\":%zu,\"lines_per_sec\":%.0f,"
+                      "\"ns_per_line\":%.1f,\"parse_ns_per_line\":%.1f,\"dispatch_ns_per_line\":%.1f,"
+                      "\"allocs_per_line\":%.3f,\"allocs_per_10k_lines\":%.1f,\"peak_heap_bytes\":%zu,"
+                      "\"lines_dispatched\":%lu,\"events\":%lu,"
+                      "\"bytes_written\":%zu,\"interned\":%zu,\"intern_hit_pct\":%.1f,"
+                      "\"arena_peak_bytes\":%zu,\"arena_overflows\":%lu,\"name_slab_bytes\":%zu,"
+                      "\"name_heap_fallbacks\":%lu}",
+                      sc.name.c_str(), lines, sc.data.size(), lines / fullBest,
+                      nsPerLine, parseNs, dispatchNs,
+                      (double)run.allocs / lines, 10000.0 * run.allocs / lines, run.peakBytes,
+                      run.linesDispatched, run.events,
+                      run.bytesWritten, run.interned, run.internHitPercent,
+                      run.arenaPeak, run.arenaOverflows, run.nameSlabBytes, run.nameHeapFallbacks);
+        std::printf("%s\n", json);
+        results.push_back(json);
+        (void)checksum;
+    }
+
+    if (!baselinePath) return 0;
+
+    std::ifstream in(baselinePath);
+    if (!in) {
+        std::fprintf(stderr, "cannot read baseline %s\n", baselinePath);
+        return 2;
+    }
+
+    int regressions = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string name;
+        double before;
+        if (!JsonString(line, "scenario", name) || !JsonNumber(line, "ns_per_line", before)) continue;
+
+        for (size_t i = 0; i < results.size(); i++) {
+            std::string current;
+            double after;
+            if (!JsonString(results[i], "scenario", current) || current != name) continue;
+            JsonNumber(results[i], "ns_per_line", after);
+            double change = before > 0 ? (after - before) / before : 0;
+            bool regressed = change > kRegressionThreshold;
+            std::fprintf(stderr, "%-16s %9.1f -> %9.1f ns/line (%+.1f%%)%s\n", name.c_str(),
+                         before, after, change * 100, regressed ? "  REGRESSION" : "");
+            if (regressed) regressions++;
+        }
+    }
+    return regressions ? 1 : 0;
+}
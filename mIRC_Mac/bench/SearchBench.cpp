@@ -0,0 +1,192 @@
+// /search throughput: fills a scrollback with generated chatter (and a
+// log with more of it), then runs SearchJob over them for a few patterns,
+// with and without the per-chunk trigram filter. Also times the bare
+// matcher against a byte-at-a-time folded compare.
+//
+//   ./mIRC_SearchBench [scrollback MB] [log MB]
+//
+// One JSON object per line on stdout.
+
+#include "../src/LogWriter.h"
+#include "../src/Scrollback.h"
+#include "../src/Search.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const char* const kWords[] = {
+    "the", "a", "to", "is", "it", "that", "and", "of", "you", "for", "on", "with", "have", "but",
+    "anyone", "know", "how", "kernel", "patch", "build", "works", "here", "again", "server", "lag",
+    "mac", "system", "seven", "powerbook", "ethernet", "driver", "thanks", "lol", "yeah", "nope",
+};
+static const int kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+// Rare words are planted once every kRareEvery lines
+static const long kRareEvery = 5000;
+
+static void MakeLine(long i, std::string& line) {
+    char nick[16];
+    std::snprintf(nick, sizeof(nick), "<user%ld> ", i % 300);
+    line.assign(nick);
+    unsigned seed = (unsigned)i * 2654435761u;
+    int words = 6 + (int)(seed % 10);
+    for (int w = 0; w < words; w++) {
+        seed = seed * 1103515245u + 12345u;
+        if (w) line += ' ';
+        line += kWords[(seed >> 16) % kWordCount];
+    }
+    if (i % kRareEvery == 0) line += " Zanzibar";
+}
+
+static void RemoveDirectory(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        unlink((path + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+static const char* NaiveFind(const char* text, size_t length, const std::string& folded) {
+    size_t m = folded.size();
+    for (size_t pos = 0; pos + m <= length; pos++) {
+        size_t i = 0;
+        while (i < m && IRCFoldChar(text[pos + i], CaseMapping::Ascii) == folded[i]) i++;
+        if (i == m) return text + pos;
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    long scrollbackMB = (argc > 1) ? std::atol(argv[1]) : 16;
+    long logMB = (argc > 2) ? std::atol(argv[2]) : 32;
+    if (scrollbackMB <= 0 || logMB < 0) return 2;
+
+    // Scrollback, with the filter kept up to date by Append()
+    ScrollbackPool pool((size_t)scrollbackMB * 1024 * 1024 + 65536);
+    Scrollback scrollback(pool, (size_t)scrollbackMB * 1024 * 1024);
+    // Generated up front so only Append() is timed
+    std::string line;
+    std::vector<std::string> generated;
+    size_t generatedBytes = 0;
+    while (generatedBytes < (size_t)scrollbackMB * 1024 * 1024) {
+        MakeLine((long)generated.size(), line);
+        generatedBytes += line.size();
+        generated.push_back(line);
+    }
+    long lines = 0;
+    BenchClock::time_point t0 = BenchClock::now();
+    for (size_t i = 0; i < generated.size(); i++) {
+        if (scrollback.Bytes() + sizeof(ScrollbackChunk) >= (size_t)scrollbackMB * 1024 * 1024) break;
+        scrollback.Append(generated[i].data(), generated[i].size());
+        lines++;
+    }
+    double appendNs = std::chrono::duration<double, std::nano>(BenchClock::now() - t0).count() / lines;
+    std::vector<std::string>().swap(generated);
+    std::printf("{\"case\":\"scrollback\",\"lines\":%ld,\"bytes\":%lu,\"append_ns_per_line\":%.1f,"
+                "\"index_bytes\":%lu,\"index_pct\":%.2f}\n",
+                lines, (unsigned long)pool.LiveBytes(), appendNs, (unsigned long)pool.IndexBytes(),
+                100.0 * pool.IndexBytes() / pool.LiveBytes());
+
+    // Older history on disk, for the log half of each search
+    char base[] = "/tmp/mirc_searchbench_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    std::string directory = std::string(base) + "/logs";
+    std::string logName;
+    {
+        LogWriter writer;
+        writer.SetDirectory(directory);
+        int handle = writer.Open("#search");
+        logName.assign(writer.FileName(handle));
+        long logLines = logMB * 1024 * 1024 / 60;
+        for (long i = 0; i < logLines; i++) {
+            MakeLine(i + 7, line);
+            writer.Append(handle, { line });
+            if ((i + 1) % 50 == 0) writer.Poll(true);
+        }
+        // Then the same lines the scrollback holds, as the live log would
+        for (uint32_t n = scrollback.FirstLine(); n < scrollback.EndLine(); n++) {
+            const char* text;
+            size_t length;
+            scrollback.GetLine(n, text, length);
+            writer.Append(handle, { std::string_view(text, length) });
+            if ((n + 1) % 50 == 0) writer.Poll(true);
+        }
+        writer.Close(handle);
+    }
+
+    static const char* const kPatterns[] = { "zanzibar", "nobody types this", "powerbook ethernet driver", "qz" };
+    std::vector<SearchHit> hits;
+    for (const char* text : kPatterns) {
+        for (int indexed = 1; indexed >= 0; indexed--) {
+            SearchJob job;
+            job.Start(text, indexed != 0);
+            job.AddSource(&scrollback, directory, logName);
+            unsigned long scrollbackMatches = 0;
+            t0 = BenchClock::now();
+            while (job.Step(16000, hits)) {
+            }
+            double seconds = std::chrono::duration<double>(BenchClock::now() - t0).count();
+            for (size_t i = 0; i < hits.size(); i++) {
+                if (!hits[i].fromLog) scrollbackMatches++;
+            }
+            hits.clear();
+
+            const SearchStats& stats = job.GetStats();
+            double covered = (stats.bytesScanned + stats.bytesSkipped) / 1048576.0;
+            std::printf("{\"case\":\"search\",\"pattern\":\"%s\",\"index\":%s,\"matches\":%lu,"
+                        "\"scrollback_matches\":%lu,\"mb_scanned\":%.1f,\"mb_skipped\":%.1f,"
+                        "\"chunks_skipped_pct\":%.1f,\"ms\":%.1f,\"mb_per_sec\":%.0f}\n",
+                        text, indexed ? "true" : "false", stats.matches, scrollbackMatches,
+                        stats.bytesScanned / 1048576.0, stats.bytesSkipped / 1048576.0,
+                        100.0 * stats.chunksSkipped / (stats.chunksSkipped + stats.chunksScanned + 1e-9),
+                        seconds * 1000, covered / seconds);
+        }
+    }
+
+    // The bare matcher over one long buffer
+    std::string haystack;
+    for (long i = 1; haystack.size() < 8 * 1024 * 1024; i++) {
+        MakeLine(i, line);
+        haystack += line;
+        haystack += '\n';
+    }
+    for (const char* text : kPatterns) {
+        SearchPattern pattern;
+        pattern.Compile(text);
+        std::string folded(text);
+        for (size_t i = 0; i < folded.size(); i++) folded[i] = IRCFoldChar(folded[i], CaseMapping::Ascii);
+
+        unsigned long found = 0, naiveFound = 0;
+        t0 = BenchClock::now();
+        for (const char* p = haystack.data(), *end = p + haystack.size(); (p = pattern.Find(p, end - p)); p++) found++;
+        double seconds = std::chrono::duration<double>(BenchClock::now() - t0).count();
+        t0 = BenchClock::now();
+        for (const char* p = haystack.data(), *end = p + haystack.size(); (p = NaiveFind(p, end - p, folded)); p++) {
+            naiveFound++;
+        }
+        double naiveSeconds = std::chrono::duration<double>(BenchClock::now() - t0).count();
+        double mb = haystack.size() / 1048576.0;
+        std::printf("{\"case\":\"kernel\",\"pattern\":\"%s\",\"matches\":%lu,\"agree\":%s,"
+                    "\"mb_per_sec\":%.0f,\"naive_mb_per_sec\":%.0f}\n",
+                    text, found, found == naiveFound ? "true" : "false", mb / seconds, mb / naiveSeconds);
+        if (found != naiveFound) return 1;
+    }
+
+    RemoveDirectory(directory);
+    rmdir(base);
+    return 0;
+}
@@ -98,18 +98,54 @@ extern QDGlobals qd;
 // Controls / Scrollbars
 typedef struct ControlRecord* ControlHandle;
 
+// Regions
+struct Region {
+    int16_t rgnSize;
+    Rect rgnBBox;
+};
+typedef Region* RgnPtr;
+typedef RgnPtr* RgnHandle;
+
 // TextEdit
 struct TERec {
     Rect viewRect;
     Rect destRect;
     Rect otherRect;
+    int16_t lineHeight;
+    int16_t fontAscent;
     Handle hText;
+    int16_t nLines;
     int16_t teLength;
     // ... extensive fields ...
 };
 typedef TERec* TEPtr;
 typedef TEPtr* TEHandle;
 
+// Styled TextEdit
+typedef unsigned char Style;
+enum { normal = 0, bold = 1, italic = 2, underline = 4, outline = 8, shadow = 16, condense = 32, extend = 64 };
+struct RGBColor {
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+};
+struct ScrpSTElement {
+    int32_t scrpStartChar;
+    int16_t scrpHeight;
+    int16_t scrpAscent;
+    int16_t scrpFont;
+    Style scrpFace;
+    char filler;
+    int16_t scrpSize;
+    RGBColor scrpColor;
+};
+struct StScrpRec {
+    int16_t scrpNStyles;
+    ScrpSTElement scrpStyleTab[1601];
+};
+typedef StScrpRec* StScrpPtr;
+typedef StScrpPtr* StScrpHandle;
+
 // Menus
 struct MenuInfo {
     // ...
@@ -143,6 +179,7 @@ void DragWindow(WindowPtr, Point, Rect*);
 long GrowWindow(WindowPtr, Point, Rect*);
 void SizeWindow(WindowPtr, int16_t, int16_t, Boolean);
 void InvalRect(const Rect*);
+void ClipRect(const Rect*);
 void EraseRect(const Rect*);
 int16_t FindWindow(Point, WindowPtr*);
 long GetWRefCon(WindowPtr);
@@ -163,6 +200,8 @@ Boolean TrackGoAway(WindowPtr, Point);
 Handle GetNewMBar(int16_t);
 void SetMenuBar(Handle);
 void DisposeHandle(Handle);
+Handle NewHandle(int32_t);
+void SetHandleSize(Handle, int32_t);
 void AppendResMenu(MenuHandle, uint32_t);
 MenuHandle GetMenuHandle(int16_t);
 
@@ -187,6 +226,8 @@ void SystemTask();
 
 // TextEdit Functions
 TEHandle TENew(const Rect*, const Rect*);
+TEHandle TEStyleNew(const Rect*, const Rect*);
+void TEStyleInsert(const void*, int32_t, StScrpHandle, TEHandle);
 void TEDispose(TEHandle);
 void TEKey(char, TEHandle);
 void TEClick(Point, Boolean, TEHandle);
@@ -195,6 +236,7 @@ void TEActivate(TEHandle);
 void TEDeactivate(TEHandle);
 void TEIdle(TEHandle);
 void TEInsert(const void*, int32_t, TEHandle);
+void TESetText(const void*, int32_t, TEHandle);
 void TESetSelect(long, long, TEHandle);
 void TEAutoView(Boolean, TEHandle);
 void TEScroll(int16_t, int16_t, TEHandle);
@@ -207,6 +249,9 @@ void TECalText(TEHandle);
 // QuickDraw Functions
 void MoveTo(int16_t, int16_t);
 void LineTo(int16_t, int16_t);
+void ScrollRect(const Rect*, int16_t, int16_t, RgnHandle);
+RgnHandle NewRgn();
+void DisposeRgn(RgnHandle);
 void DrawString(const unsigned char*);
 int16_t StringWidth(const unsigned char*);
 void TextFont(int16_t);
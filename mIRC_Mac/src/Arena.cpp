@@ -0,0 +1,134 @@
+#include "Arena.h"
+#include <cstring>
+
+// Everything we hand out is at most pointer-aligned data; 68k needs 2,
+// modern targets 8.
+static const size_t kAlign = 8;
+
+// LineArena
+
+LineArena::LineArena(size_t blockSize)
+    : block(new char[blockSize]), blockSize(blockSize), used(0), peak(0),
+      overflow(nullptr), resets(0), overflowAllocs(0) {
+}
+
+LineArena::~LineArena() {
+    Reset();
+    delete[] block;
+}
+
+void* LineArena::Alloc(size_t size) {
+    size_t start = (used + kAlign - 1) & ~(kAlign - 1);
+    if (start + size <= blockSize) {
+        used = start + size;
+        if (used > peak) peak = used;
+        return block + start;
+    }
+
+    // Spill to the heap; the header keeps the chunk on our free-at-reset list
+    overflowAllocs++;
+    char* mem = new char[sizeof(Overflow) + kAlign + size];
+    Overflow* node = (Overflow*)mem;
+    node->next = overflow;
+    overflow = node;
+    return mem + ((sizeof(Overflow) + kAlign - 1) & ~(kAlign - 1));
+}
+
+std::string_view LineArena::Concat(std::initializer_list<std::string_view> pieces) {
+    size_t length = 0;
+    for (std::string_view piece : pieces) length += piece.size();
+
+    char* dst = (char*)Alloc(length);
+    char* p = dst;
+    for (std::string_view piece : pieces) {
+        memcpy(p, piece.data(), piece.size());
+        p += piece.size();
+    }
+    return std::string_view(dst, length);
+}
+
+void LineArena::Reset() {
+    while (overflow) {
+        Overflow* next = overflow->next;
+        delete[] (char*)overflow;
+        overflow = next;
+    }
+    used = 0;
+    resets++;
+}
+
+// NamePool
+
+static const size_t kSlotSizes[NamePool::kClassCount] = { 16, 32, 64 };
+static const int kSlotsPerSlab = 32;
+
+NamePool::NamePool() : slabBytes(0), heapFallbacks(0) {
+    for (int c = 0; c < kClassCount; c++) {
+        freeLists[c] = nullptr;
+        inUse[c] = 0;
+    }
+}
+
+NamePool::~NamePool() {
+    for (size_t i = 0; i < slabs.size(); i++) delete[] slabs[i];
+}
+
+int NamePool::ClassFor(size_t length) {
+    for (int c = 0; c < kClassCount; c++) {
+        if (length + 1 <= kSlotSizes[c]) return c;
+    }
+    return -1;
+}
+
+size_t NamePool::Footprint(size_t length) {
+    int sizeClass = ClassFor(length);
+    return (sizeClass < 0) ? length + 1 : kSlotSizes[sizeClass];
+}
+
+size_t NamePool::SlotSize(int sizeClass) {
+    return kSlotSizes[sizeClass];
+}
+
+void NamePool::Grow(int sizeClass) {
+    size_t slotSize = kSlotSizes[sizeClass];
+    char* slab = new char[slotSize * kSlotsPerSlab];
+    slabs.push_back(slab);
+    slabBytes += slotSize * kSlotsPerSlab;
+    for (int i = kSlotsPerSlab - 1; i >= 0; i--) {
+        FreeSlot* slot = (FreeSlot*)(slab + i * slotSize);
+        slot->next = freeLists[sizeClass];
+        freeLists[sizeClass] = slot;
+    }
+}
+
+std::string_view NamePool::Acquire(std::string_view name) {
+    int sizeClass = ClassFor(name.size());
+    char* dst;
+    if (sizeClass < 0) {
+        heapFallbacks++;
+        dst = new char[name.size() + 1];
+    } else {
+        if (!freeLists[sizeClass]) Grow(sizeClass);
+        FreeSlot* slot = freeLists[sizeClass];
+        freeLists[sizeClass] = slot->next;
+        inUse[sizeClass]++;
+        dst = (char*)slot;
+    }
+    memcpy(dst, name.data(), name.size());
+    dst[name.size()] = '\0';
+    return std::string_view(dst, name.size());
+}
+
+void NamePool::Release(std::string_view name) {
+    if (!name.data()) return;
+
+    int sizeClass = ClassFor(name.size());
+    if (sizeClass < 0) {
+        delete[] name.data();
+        return;
+    }
+    FreeSlot* slot = (FreeSlot*)name.data();
+    slot->next = freeLists[sizeClass];
+    freeLists[sizeClass] = slot;
+    inUse[sizeClass]--;
+}
@@ -0,0 +1,89 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for objects that live only while one protocol line is
+// being handled. IRCClient resets it before parsing each line, once the
+// previous line's events have been delivered, so nothing here needs
+// freeing and the heap never sees per-line churn.
+// If a line ever needs more than the block, extra blocks come from the
+// heap and are counted; they are freed on the next Reset().
+class LineArena {
+public:
+    explicit LineArena(size_t blockSize);
+    ~LineArena();
+
+    void* Alloc(size_t size);
+    // Concatenates the pieces into arena memory
+    std::string_view Concat(std::initializer_list<std::string_view> pieces);
+    void Reset();
+
+    size_t Used() const { return used; }
+    size_t BlockSize() const { return blockSize; }
+    size_t Peak() const { return peak; }
+    unsigned long Resets() const { return resets; }
+    unsigned long OverflowAllocs() const { return overflowAllocs; }
+
+private:
+    struct Overflow {
+        Overflow* next;
+    };
+
+    char* block;
+    size_t blockSize;
+    size_t used;
+    size_t peak;
+    Overflow* overflow;
+    unsigned long resets;
+    unsigned long overflowAllocs;
+
+    LineArena(const LineArena&);
+    LineArena& operator=(const LineArena&);
+};
+
+// Fixed-size slot pools for long-lived small strings (nicks, channel
+// names). Slots come from slabs that are never returned to the heap, so
+// joining and leaving channels all day does not fragment it. Strings are
+// NUL terminated; anything too long for the largest class is heap
+// allocated and counted.
+class NamePool {
+public:
+    static const int kClassCount = 3;
+
+    NamePool();
+    ~NamePool();
+
+    std::string_view Acquire(std::string_view name);
+    void Release(std::string_view name);
+    // Bytes a name of this length really occupies (its slot, or heap block)
+    static size_t Footprint(size_t length);
+    static size_t SlotSize(int sizeClass);
+
+    unsigned SlotsInUse(int sizeClass) const { return inUse[sizeClass]; }
+    size_t SlabBytes() const { return slabBytes; }
+    unsigned long HeapFallbacks() const { return heapFallbacks; }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    FreeSlot* freeLists[kClassCount];
+    unsigned inUse[kClassCount];
+    std::vector<char*> slabs;
+    size_t slabBytes;
+    unsigned long heapFallbacks;
+
+    static int ClassFor(size_t length);
+    void Grow(int sizeClass);
+
+    NamePool(const NamePool&);
+    NamePool& operator=(const NamePool&);
+};
+
+#endif // ARENA_H
@@ -0,0 +1,35 @@
+#include "CaseMap.h"
+
+CaseMapping ParseCaseMapping(std::string_view value) {
+    if (value == "ascii") return CaseMapping::Ascii;
+    if (value == "strict-rfc1459") return CaseMapping::StrictRfc1459;
+    return CaseMapping::Rfc1459;
+}
+
+bool IRCEquals(std::string_view a, std::string_view b, CaseMapping mapping) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i] != b[i] && IRCFoldChar(a[i], mapping) != IRCFoldChar(b[i], mapping)) return false;
+    }
+    return true;
+}
+
+int IRCCompare(std::string_view a, std::string_view b, CaseMapping mapping) {
+    size_t n = (a.size() < b.size()) ? a.size() : b.size();
+    for (size_t i = 0; i < n; i++) {
+        unsigned char ca = (unsigned char)IRCFoldChar(a[i], mapping);
+        unsigned char cb = (unsigned char)IRCFoldChar(b[i], mapping);
+        if (ca != cb) return (ca < cb) ? -1 : 1;
+    }
+    if (a.size() == b.size()) return 0;
+    return (a.size() < b.size()) ? -1 : 1;
+}
+
+uint32_t IRCHash(std::string_view s, CaseMapping mapping) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < s.size(); i++) {
+        hash ^= (unsigned char)IRCFoldChar(s[i], mapping);
+        hash *= 16777619u;
+    }
+    return hash;
+}
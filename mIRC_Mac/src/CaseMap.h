@@ -0,0 +1,36 @@
+#ifndef CASE_MAP_H
+#define CASE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// IRC case mappings as advertised by ISUPPORT CASEMAPPING. rfc1459 (the
+// default) also treats []\^ as the upper case of {}|~.
+enum class CaseMapping : uint8_t {
+    Ascii,
+    Rfc1459,
+    StrictRfc1459  // rfc1459 without ^~
+};
+
+// Parses an ISUPPORT CASEMAPPING value; unknown values map to Rfc1459
+CaseMapping ParseCaseMapping(std::string_view value);
+
+// Folds one byte to the mapping's lower case
+inline char IRCFoldChar(char c, CaseMapping mapping) {
+    unsigned char u = (unsigned char)c;
+    if (u >= 'A' && u <= 'Z') return (char)(u + 32);
+    if (mapping == CaseMapping::Ascii) return c;
+    if (u >= '[' && u <= ']') return (char)(u + 32);  // [\] -> {|}
+    if (u == '^' && mapping == CaseMapping::Rfc1459) return '~';
+    return c;
+}
+
+bool IRCEquals(std::string_view a, std::string_view b, CaseMapping mapping);
+// <0, 0 or >0 comparing the folded bytes; the order member lists sort in
+int IRCCompare(std::string_view a, std::string_view b, CaseMapping mapping);
+
+// FNV-1a over the folded bytes, so equal identifiers hash equally
+uint32_t IRCHash(std::string_view s, CaseMapping mapping);
+
+#endif // CASE_MAP_H
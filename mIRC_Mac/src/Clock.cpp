@@ -0,0 +1,82 @@
+#include "Clock.h"
+
+#if defined(LOCAL_TESTING) || defined(__unix__)
+    #include <time.h>
+#else
+    #include <Timer.h>
+    #include <Events.h>
+    #include <OSUtils.h>
+#endif
+
+#if defined(LOCAL_TESTING) || defined(__unix__)
+
+uint32_t ClockMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000);
+}
+
+uint32_t ClockMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000u + ts.tv_nsec / 1000000);
+}
+
+void ClockLocalDate(ClockDate& out) {
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    out.year = local.tm_year + 1900;
+    out.month = local.tm_mon + 1;
+    out.day = local.tm_mday;
+    out.hour = local.tm_hour;
+    out.minute = local.tm_min;
+    out.second = local.tm_sec;
+}
+
+int32_t ClockUTCOffset() {
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    return (int32_t)local.tm_gmtoff;
+}
+
+#else
+
+uint32_t ClockMicros() {
+    UnsignedWide us;
+    Microseconds(&us);
+    return us.lo;
+}
+
+uint32_t ClockMillis() {
+    // TickCount is 1/60 s; fine for coarse timeouts and cheaper than the
+    // Microseconds trap. Scaled in 64 bits so the result keeps wrapping
+    // modulo 2^32 rather than jumping after ~16 days of uptime.
+    return (uint32_t)(((uint64_t)TickCount() * 50) / 3);
+}
+
+void ClockLocalDate(ClockDate& out) {
+    // The Mac clock already runs in local time
+    unsigned long secs;
+    DateTimeRec date;
+    GetDateTime(&secs);
+    SecondsToDate(secs, &date);
+    out.year = date.year;
+    out.month = date.month;
+    out.day = date.day;
+    out.hour = date.hour;
+    out.minute = date.minute;
+    out.second = date.second;
+}
+
+int32_t ClockUTCOffset() {
+    // gmtDelta is a signed 24-bit value in the low bytes
+    MachineLocation location;
+    ReadLocation(&location);
+    int32_t delta = location.u.gmtDelta & 0x00FFFFFF;
+    if (delta & 0x00800000) delta |= (int32_t)0xFF000000;
+    return delta;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+
+// Monotonic time for budgets and instrumentation. Both values wrap, so
+// only ever compare differences: (uint32_t)(now - then).
+//   Mac:   Microseconds() / TickCount()
+//   POSIX: clock_gettime(CLOCK_MONOTONIC)
+uint32_t ClockMicros();
+uint32_t ClockMillis();
+
+// Local wall-clock time, for log stamps and daily rotation
+//   Mac:   GetDateTime() / SecondsToDate()
+//   POSIX: time() / localtime_r()
+struct ClockDate {
+    int year;
+    int month;   // 1-12
+    int day;     // 1-31
+    int hour;
+    int minute;
+    int second;
+};
+void ClockLocalDate(ClockDate& out);
+
+// Seconds local time is ahead of UTC, for IRCv3 server-time stamps
+//   Mac:   ReadLocation() gmtDelta
+//   POSIX: localtime_r() tm_gmtoff
+int32_t ClockUTCOffset();
+
+#endif // CLOCK_H
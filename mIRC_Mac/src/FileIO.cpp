@@ -0,0 +1,198 @@
+#include "FileIO.h"
+#include <cstring>
+
+#if defined(LOCAL_TESTING) || defined(__unix__)
+    #include <dirent.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #include <Files.h>
+#endif
+
+std::string FileJoin(const std::string& directory, const std::string& name) {
+    std::string path(directory);
+    path += kPathSeparator;
+    path += name;
+    return path;
+}
+
+#if defined(LOCAL_TESTING) || defined(__unix__)
+
+const char kPathSeparator = '/';
+const char kLineEnd = '\n';
+
+bool FileMakeDirectory(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+long FileSize(const std::string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) return -1;
+    return (long)info.st_size;
+}
+
+bool FileAppend(const std::string& path, const char* data, size_t length, bool sync) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = write(fd, data + done, length - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        done += (size_t)n;
+    }
+    if (sync) fsync(fd);
+    return close(fd) == 0;
+}
+
+bool FileList(const std::string& directory, std::vector<std::string>& names) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return false;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    return true;
+}
+
+int FileOpenRead(const std::string& path) {
+    return open(path.c_str(), O_RDONLY);
+}
+
+long FileReadAt(int handle, uint32_t offset, char* buffer, size_t length) {
+    for (;;) {
+        ssize_t n = pread(handle, buffer, length, (off_t)offset);
+        if (n >= 0 || errno != EINTR) return (long)n;
+    }
+}
+
+void FileClose(int handle) {
+    if (handle >= 0) close(handle);
+}
+
+#ifdef FILE_MMAP
+
+const char* FileMap(const std::string& path, size_t& length) {
+    length = 0;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) return nullptr;
+    length = (size_t)info.st_size;
+    return (const char*)data;
+}
+
+void FileUnmap(const char* data, size_t length) {
+    if (data) munmap((void*)data, length);
+}
+
+#endif
+
+#else
+
+const char kPathSeparator = ':';
+const char kLineEnd = '\r';
+
+// Plain text, opened by SimpleText on a double-click
+static const OSType kTextCreator = 'ttxt';
+static const OSType kTextType = 'TEXT';
+
+static void ToPascal(const std::string& text, Str255 out) {
+    size_t length = text.size() > 255 ? 255 : text.size();
+    out[0] = (unsigned char)length;
+    memcpy(out + 1, text.data(), length);
+}
+
+bool FileMakeDirectory(const std::string& path) {
+    Str255 name;
+    ToPascal(path, name);
+    long dirID;
+    OSErr err = DirCreate(0, 0, name, &dirID);
+    return err == noErr || err == dupFNErr;
+}
+
+long FileSize(const std::string& path) {
+    Str255 name;
+    ToPascal(path, name);
+    short refNum;
+    if (HOpenDF(0, 0, name, fsRdPerm, &refNum) != noErr) return -1;
+    long size = -1;
+    if (GetEOF(refNum, &size) != noErr) size = -1;
+    FSClose(refNum);
+    return size;
+}
+
+bool FileAppend(const std::string& path, const char* data, size_t length, bool sync) {
+    Str255 name;
+    ToPascal(path, name);
+    OSErr err = HCreate(0, 0, name, kTextCreator, kTextType);
+    if (err != noErr && err != dupFNErr) return false;
+
+    short refNum;
+    if (HOpenDF(0, 0, name, fsWrPerm, &refNum) != noErr) return false;
+    err = SetFPos(refNum, fsFromLEOF, 0);
+    long count = (long)length;
+    if (err == noErr) err = FSWrite(refNum, &count, data);
+    FSClose(refNum);
+    if (sync) FlushVol(nil, 0);
+    return err == noErr;
+}
+
+bool FileList(const std::string& directory, std::vector<std::string>& names) {
+    Str255 name;
+    ToPascal(directory, name);
+
+    // Find the folder's id, then walk its entries by index
+    CInfoPBRec pb;
+    memset(&pb, 0, sizeof(pb));
+    pb.dirInfo.ioNamePtr = name;
+    pb.dirInfo.ioFDirIndex = 0;
+    if (PBGetCatInfoSync(&pb) != noErr) return false;
+    long dirID = pb.dirInfo.ioDrDirID;
+
+    for (short index = 1;; index++) {
+        Str255 entry;
+        memset(&pb, 0, sizeof(pb));
+        pb.hFileInfo.ioNamePtr = entry;
+        pb.hFileInfo.ioFDirIndex = index;
+        pb.hFileInfo.ioDirID = dirID;
+        if (PBGetCatInfoSync(&pb) != noErr) break;
+        if (pb.hFileInfo.ioFlAttrib & ioDirMask) continue;
+        names.push_back(std::string((const char*)entry + 1, entry[0]));
+    }
+    return true;
+}
+
+int FileOpenRead(const std::string& path) {
+    Str255 name;
+    ToPascal(path, name);
+    short refNum;
+    if (HOpenDF(0, 0, name, fsRdPerm, &refNum) != noErr) return -1;
+    return refNum;
+}
+
+long FileReadAt(int handle, uint32_t offset, char* buffer, size_t length) {
+    if (SetFPos((short)handle, fsFromStart, (long)offset) != noErr) return -1;
+    long count = (long)length;
+    OSErr err = FSRead((short)handle, &count, buffer);
+    return (err == noErr || err == eofErr) ? count : -1;
+}
+
+void FileClose(int handle) {
+    if (handle >= 0) FSClose((short)handle);
+}
+
+#endif
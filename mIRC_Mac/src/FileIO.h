@@ -0,0 +1,46 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The little file access logs and history need, on top of POSIX calls
+// or the Mac File Manager. Paths are built with kPathSeparator; on the
+// Mac they are partial paths from the application's folder.
+//
+// Files are opened per call or per reader and never shared, so the Mac
+// only ever holds a handful of FCBs.
+
+#if (defined(LOCAL_TESTING) || defined(__unix__)) && !defined(HISTORY_NO_MMAP)
+    // Whole files can be mapped instead of read through a page cache
+    #define FILE_MMAP 1
+#endif
+
+extern const char kPathSeparator;
+extern const char kLineEnd;  // what LogWriter ends lines with
+
+std::string FileJoin(const std::string& directory, const std::string& name);
+
+bool FileMakeDirectory(const std::string& path);
+// Size in bytes, or -1 if the file does not exist
+long FileSize(const std::string& path);
+// Appends with a single open/write/close; 'sync' forces it to the disk
+bool FileAppend(const std::string& path, const char* data, size_t length, bool sync);
+// Names (not paths) of the plain files in 'directory'
+bool FileList(const std::string& directory, std::vector<std::string>& names);
+
+// Read-only handle for random access; -1 when the file cannot be opened
+int FileOpenRead(const std::string& path);
+// Bytes read, or -1 on error
+long FileReadAt(int handle, uint32_t offset, char* buffer, size_t length);
+void FileClose(int handle);
+
+#ifdef FILE_MMAP
+// Maps the whole file read-only; null if missing or empty
+const char* FileMap(const std::string& path, size_t& length);
+void FileUnmap(const char* data, size_t length);
+#endif
+
+#endif // FILE_IO_H
@@ -0,0 +1,92 @@
+#include "HeapStats.h"
+
+#include <cstdlib>
+#include <new>
+
+static const char* const kScopeNames[kHeapScopeCount] = {
+    "Other",
+    "ParseLine",
+    "ProcessMessage",
+    "AppendText",
+    "WindowCreate",
+};
+
+static HeapScopeStats gScopeStats[kHeapScopeCount];
+static HeapScopeStats gTotals;
+
+const char* HeapScopeName(int scope) {
+    return (scope >= 0 && scope < kHeapScopeCount) ? kScopeNames[scope] : "?";
+}
+
+const HeapScopeStats& GetHeapScopeStats(int scope) {
+    return gScopeStats[(scope >= 0 && scope < kHeapScopeCount) ? scope : kHeapOther];
+}
+
+const HeapScopeStats& GetHeapTotals() {
+    return gTotals;
+}
+
+#ifdef HEAP_STATS
+
+bool HeapStatsEnabled() { return true; }
+
+// The client is single threaded, so a plain global is enough
+static uint8_t gCurrentScope = kHeapOther;
+
+HeapScopeGuard::HeapScopeGuard(HeapScope scope) : saved(gCurrentScope) {
+    gCurrentScope = (uint8_t)scope;
+}
+
+HeapScopeGuard::~HeapScopeGuard() {
+    gCurrentScope = saved;
+}
+
+// Each block is preceded by its size and owning scope, padded so the
+// caller still gets max_align_t alignment.
+struct BlockHeader {
+    size_t size;
+    uint8_t scope;
+};
+static const size_t kHeaderSize =
+    (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+static void Charge(HeapScopeStats& s, size_t size) {
+    s.allocs++;
+    s.bytes += size;
+    s.live += size;
+    if (s.live > s.peak) s.peak = s.live;
+}
+
+static void Credit(HeapScopeStats& s, size_t size) {
+    s.frees++;
+    s.live -= size;
+}
+
+void* operator new(std::size_t size) {
+    char* p = (char*)std::malloc(size + kHeaderSize);
+    if (!p) throw std::bad_alloc();
+    BlockHeader* header = (BlockHeader*)p;
+    header->size = size;
+    header->scope = gCurrentScope;
+    Charge(gScopeStats[header->scope], size);
+    Charge(gTotals, size);
+    return p + kHeaderSize;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    BlockHeader* header = (BlockHeader*)((char*)p - kHeaderSize);
+    Credit(gScopeStats[header->scope], header->size);
+    Credit(gTotals, header->size);
+    std::free(header);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+#else
+
+bool HeapStatsEnabled() { return false; }
+
+#endif
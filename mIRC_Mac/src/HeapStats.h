@@ -0,0 +1,60 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Opt-in heap accounting for the Linux build (-DMIRC_HEAP_STATS=ON defines
+// HEAP_STATS). Global operator new/delete are replaced so every allocation
+// is charged to the innermost HEAP_SCOPE active when it was made; frees
+// are credited back to that same scope. Without HEAP_STATS the scopes
+// compile to nothing and the counters stay zero.
+
+enum HeapScope {
+    kHeapOther,
+    kHeapParseLine,
+    kHeapProcessMessage,
+    kHeapAppendText,
+    kHeapWindowCreate,
+    kHeapScopeCount
+};
+
+struct HeapScopeStats {
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long long bytes;  // total ever allocated
+    size_t live;
+    size_t peak;
+};
+
+const char* HeapScopeName(int scope);
+const HeapScopeStats& GetHeapScopeStats(int scope);
+// Sum over all scopes; peak is the high-water mark of the whole heap
+const HeapScopeStats& GetHeapTotals();
+bool HeapStatsEnabled();
+
+#ifdef HEAP_STATS
+
+class HeapScopeGuard {
+public:
+    explicit HeapScopeGuard(HeapScope scope);
+    ~HeapScopeGuard();
+
+private:
+    uint8_t saved;
+
+    HeapScopeGuard(const HeapScopeGuard&);
+    HeapScopeGuard& operator=(const HeapScopeGuard&);
+};
+
+#define HEAP_SCOPE_JOIN2(a, b) a##b
+#define HEAP_SCOPE_JOIN(a, b) HEAP_SCOPE_JOIN2(a, b)
+#define HEAP_SCOPE(scope) HeapScopeGuard HEAP_SCOPE_JOIN(heapScope_, __LINE__)(scope)
+
+#else
+
+#define HEAP_SCOPE(scope) ((void)0)
+
+#endif
+
+#endif // HEAP_STATS_H
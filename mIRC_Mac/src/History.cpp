@@ -0,0 +1,298 @@
+#include "History.h"
+#include "LogWriter.h"
+#include <algorithm>
+#include <cstring>
+
+static bool IsLineEnd(char c) {
+    // Either platform's logs can be read on the other
+    return c == '\n' || c == '\r';
+}
+
+static uint32_t GetBigEndian(const char* in) {
+    const unsigned char* p = (const unsigned char*)in;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Minute of day from a "[hh:mm] " stamp, -1 if the line has none
+static int StampMinute(std::string_view line) {
+    if (line.size() < 7 || line[0] != '[' || line[3] != ':' || line[6] != ']') return -1;
+    for (int i : { 1, 2, 4, 5 }) {
+        if (line[i] < '0' || line[i] > '9') return -1;
+    }
+    return ((line[1] - '0') * 10 + (line[2] - '0')) * 60 + (line[4] - '0') * 10 + (line[5] - '0');
+}
+
+HistoryReader::HistoryReader()
+    : pages(nullptr), openSegment(-1), openHandle(-1), useClock(0), pageReads(0), cacheHits(0) {
+}
+
+HistoryReader::~HistoryReader() {
+    Close();
+}
+
+bool HistoryReader::Open(const std::string& directory, std::string_view name) {
+    Close();
+
+    std::vector<std::string> names;
+    if (!FileList(directory, names)) return false;
+
+    // <name>.<yyyymmdd>.log
+    for (size_t i = 0; i < names.size(); i++) {
+        const std::string& file = names[i];
+        if (file.size() != name.size() + 13 || file.compare(0, name.size(), name.data(), name.size()) != 0) continue;
+        const char* rest = file.c_str() + name.size();
+        if (rest[0] != '.' || strcmp(rest + 9, ".log") != 0) continue;
+
+        int date = 0;
+        bool digits = true;
+        for (int d = 1; d <= 8; d++) {
+            if (rest[d] < '0' || rest[d] > '9') digits = false;
+            date = date * 10 + (rest[d] - '0');
+        }
+        if (!digits) continue;
+
+        Segment segment;
+        segment.date = date;
+        segment.path = FileJoin(directory, file);
+        segment.sized = false;
+        segment.size = 0;
+        segment.mapped = nullptr;
+        segment.mappedLength = 0;
+        segments.push_back(segment);
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.date < b.date; });
+    return true;
+}
+
+void HistoryReader::Close() {
+#ifdef FILE_MMAP
+    for (size_t i = 0; i < segments.size(); i++) FileUnmap(segments[i].mapped, segments[i].mappedLength);
+#endif
+    segments.clear();
+    FileClose(openHandle);
+    openHandle = -1;
+    openSegment = -1;
+    delete[] pages;
+    pages = nullptr;
+}
+
+HistoryPos HistoryReader::Begin() const {
+    HistoryPos pos = { 0, 0 };
+    return pos;
+}
+
+HistoryPos HistoryReader::End() {
+    HistoryPos pos = { 0, 0 };
+    if (!segments.empty()) {
+        pos.segment = (int)segments.size() - 1;
+        pos.offset = SizeOf(pos.segment);
+    }
+    return pos;
+}
+
+uint32_t HistoryReader::SizeOf(int segment) {
+    Segment& s = segments[segment];
+    if (!s.sized) {
+        long size = FileSize(s.path);
+        s.size = (size > 0) ? (uint32_t)size : 0;
+        s.sized = true;
+    }
+    return s.size;
+}
+
+const HistoryReader::Page* HistoryReader::LoadPage(int segment, uint32_t number) {
+    if (!pages) {
+        pages = new Page[kCachePages];
+        for (int i = 0; i < kCachePages; i++) {
+            pages[i].segment = -1;
+            pages[i].lastUse = 0;
+        }
+    }
+
+    Page* victim = &pages[0];
+    for (int i = 0; i < kCachePages; i++) {
+        Page& page = pages[i];
+        if (page.segment == segment && page.number == number) {
+            cacheHits++;
+            page.lastUse = ++useClock;
+            return &page;
+        }
+        if (page.lastUse < victim->lastUse) victim = &page;
+    }
+
+    if (openSegment != segment) {
+        FileClose(openHandle);
+        openHandle = FileOpenRead(segments[segment].path);
+        openSegment = segment;
+    }
+    long got = (openHandle >= 0) ? FileReadAt(openHandle, number * (uint32_t)kPageSize, victim->data, kPageSize) : -1;
+    pageReads++;
+    victim->segment = segment;
+    victim->number = number;
+    victim->length = (got > 0) ? (uint32_t)got : 0;
+    victim->lastUse = ++useClock;
+    return victim;
+}
+
+const char* HistoryReader::Span(int segment, uint32_t offset, size_t& length) {
+    uint32_t size = SizeOf(segment);
+    if (offset >= size) {
+        length = 0;
+        return nullptr;
+    }
+    if (length > size - offset) length = size - offset;
+
+#ifdef FILE_MMAP
+    Segment& s = segments[segment];
+    if (!s.mapped) s.mapped = FileMap(s.path, s.mappedLength);
+    if (!s.mapped || offset >= s.mappedLength) {
+        length = 0;
+        return nullptr;
+    }
+    if (length > s.mappedLength - offset) length = s.mappedLength - offset;
+    return s.mapped + offset;
+#else
+    uint32_t first = offset / kPageSize;
+    uint32_t last = (uint32_t)((offset + length - 1) / kPageSize);
+    uint32_t within = offset - first * (uint32_t)kPageSize;
+
+    const Page* page = LoadPage(segment, first);
+    if (first == last || page->length < kPageSize) {
+        if (within >= page->length) {
+            length = 0;
+            return nullptr;
+        }
+        if (length > page->length - within) length = page->length - within;
+        return page->data + within;
+    }
+
+    // Straddles two pages (length never exceeds one page): stitch them
+    scratch.resize(length);
+    size_t head = kPageSize - within;
+    memcpy(&scratch[0], page->data + within, head);
+    page = LoadPage(segment, last);
+    size_t tail = std::min(length - head, (size_t)page->length);
+    memcpy(&scratch[head], page->data, tail);
+    length = head + tail;
+    return &scratch[0];
+#endif
+}
+
+bool HistoryReader::Settle(HistoryPos& pos) {
+    if (segments.empty()) return false;
+    while (pos.offset >= SizeOf(pos.segment)) {
+        if (pos.segment + 1 >= (int)segments.size()) return false;
+        pos.segment++;
+        pos.offset = 0;
+    }
+    return true;
+}
+
+bool HistoryReader::NextLine(HistoryPos& pos, std::string_view& line) {
+    if (!Settle(pos)) return false;
+
+    size_t length = kMaxLineBytes + 1;
+    const char* p = Span(pos.segment, pos.offset, length);
+    if (!p || length == 0) return false;
+
+    size_t end = 0;
+    while (end < length && !IsLineEnd(p[end])) end++;
+    if (end < length) {
+        line = std::string_view(p, end);
+        pos.offset += (uint32_t)end + 1;
+    } else {
+        // No line end in reach: a very long line, or the unfinished tail
+        size_t n = (length < kMaxLineBytes) ? length : kMaxLineBytes;
+        line = std::string_view(p, n);
+        pos.offset += (uint32_t)n;
+    }
+    return true;
+}
+
+bool HistoryReader::PrevLine(HistoryPos& pos, std::string_view& line) {
+    if (segments.empty()) return false;
+    while (pos.offset == 0) {
+        if (pos.segment == 0) return false;
+        pos.segment--;
+        pos.offset = SizeOf(pos.segment);
+    }
+
+    uint32_t end = pos.offset;
+    uint32_t from = (end > kMaxLineBytes + 1) ? end - (uint32_t)(kMaxLineBytes + 1) : 0;
+    size_t length = end - from;
+    const char* p = Span(pos.segment, from, length);
+    if (!p || length < end - from) return false;
+
+    size_t stop = length;
+    if (IsLineEnd(p[stop - 1])) stop--;
+    size_t start = stop;
+    while (start > 0 && !IsLineEnd(p[start - 1])) start--;
+
+    line = std::string_view(p + start, stop - start);
+    pos.offset = from + (uint32_t)start;
+    return true;
+}
+
+HistoryPos HistoryReader::Seek(int date, uint32_t secondOfDay) {
+    // First segment on or after the date
+    size_t lo = 0, hi = segments.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (segments[mid].date < date) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == segments.size()) return End();
+
+    HistoryPos pos = { (int)lo, 0 };
+    if (segments[lo].date > date) return pos;
+    return SeekInSegment((int)lo, secondOfDay);
+}
+
+HistoryPos HistoryReader::SeekInSegment(int segment, uint32_t secondOfDay) {
+    HistoryPos pos = { segment, 0 };
+    // Stamps only have minutes, so earlier lines may share the wanted one
+    int wanted = (int)(secondOfDay / 60);
+    uint32_t minuteStart = (uint32_t)wanted * 60;
+
+    // Last index record from before the wanted minute, found by bisection
+    std::string indexPath = segments[segment].path;
+    indexPath.replace(indexPath.size() - 4, 4, ".idx");
+    long indexSize = FileSize(indexPath);
+    int handle = (indexSize > 0) ? FileOpenRead(indexPath) : -1;
+    if (handle >= 0) {
+        long lo = 0, hi = indexSize / (long)LogWriter::kIndexRecordSize;
+        char record[LogWriter::kIndexRecordSize];
+        while (lo < hi) {
+            long mid = (lo + hi) / 2;
+            if (FileReadAt(handle, (uint32_t)(mid * LogWriter::kIndexRecordSize), record, sizeof(record)) !=
+                (long)sizeof(record)) {
+                break;
+            }
+            if (GetBigEndian(record + 8) < minuteStart) {
+                pos.offset = GetBigEndian(record + 4);
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        FileClose(handle);
+    }
+    if (pos.offset > SizeOf(segment)) pos.offset = 0;
+
+    // Then a short scan
+    HistoryPos here = pos;
+    std::string_view line;
+    while (NextLine(here, line) && here.segment == segment) {
+        int minute = StampMinute(line);
+        if (minute >= wanted) return pos;
+        pos = here;
+    }
+    return pos;
+}
+
+size_t HistoryReader::MappedBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < segments.size(); i++) bytes += segments[i].mappedLength;
+    return bytes;
+}
@@ -0,0 +1,107 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "FileIO.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A place in a target's on-disk history: byte offset into one day file
+struct HistoryPos {
+    int segment;
+    uint32_t offset;
+
+    bool operator==(const HistoryPos& other) const { return segment == other.segment && offset == other.offset; }
+    bool operator!=(const HistoryPos& other) const { return !(*this == other); }
+    bool operator<(const HistoryPos& other) const {
+        return segment < other.segment || (segment == other.segment && offset < other.offset);
+    }
+};
+
+// Reads back what LogWriter wrote for one target, a line at a time in
+// either direction, without ever loading a whole file. The history is
+// the target's day files (segments) in date order. Open() only lists the
+// directory and sizes are looked up as segments are reached, so opening
+// costs the same however much history there is.
+//
+// Under FILE_MMAP each segment is mapped the first time it is touched.
+// Otherwise bytes come through a small LRU cache of kPageSize pages, read
+// with one File Manager call per miss. Seeking to a date is a binary
+// search over the segments and then over that day's sparse index.
+class HistoryReader {
+public:
+    static const size_t kPageSize = 4096;
+    static const int kCachePages = 8;
+    // Longer lines are returned in pieces of this size
+    static const size_t kMaxLineBytes = 2048;
+
+    HistoryReader();
+    ~HistoryReader();
+
+    // Finds the day files for 'name' (a LogWriter::FileName) in 'directory'
+    bool Open(const std::string& directory, std::string_view name);
+    void Close();
+
+    int SegmentCount() const { return (int)segments.size(); }
+    // yyyymmdd of a segment
+    int SegmentDate(int segment) const { return segments[segment].date; }
+    HistoryPos Begin() const;
+    HistoryPos End();
+
+    // Moves 'pos' off the end of a segment to the start of the next line;
+    // false if there is none
+    bool Settle(HistoryPos& pos);
+    // The line starting at 'pos', which then moves past it; false at End().
+    // 'line' excludes the line end and is valid until the next call.
+    bool NextLine(HistoryPos& pos, std::string_view& line);
+    // The line ending at 'pos', which then moves to its start; false at Begin()
+    bool PrevLine(HistoryPos& pos, std::string_view& line);
+
+    // First line logged at or after the given local date and time
+    HistoryPos Seek(int date, uint32_t secondOfDay);
+
+    unsigned long PageReads() const { return pageReads; }
+    unsigned long CacheHits() const { return cacheHits; }
+    size_t MappedBytes() const;
+
+private:
+    struct Segment {
+        int date;
+        std::string path;    // the .log file
+        bool sized;
+        uint32_t size;       // as of when it was first reached
+        const char* mapped;  // FILE_MMAP: whole file, null until touched
+        size_t mappedLength;
+    };
+
+    struct Page {
+        int segment;         // -1 when empty
+        uint32_t number;
+        uint32_t length;
+        unsigned long lastUse;
+        char data[kPageSize];
+    };
+
+    std::vector<Segment> segments;
+    Page* pages;             // kCachePages, allocated on first use
+    int openSegment;         // segment 'openHandle' reads from
+    int openHandle;
+    std::vector<char> scratch;  // spans that straddle two pages
+    unsigned long useClock;
+    unsigned long pageReads;
+    unsigned long cacheHits;
+
+    // Bytes [offset, offset + length) of a segment, contiguous; length is
+    // clipped at the end of the segment and at most kMaxLineBytes + 1
+    uint32_t SizeOf(int segment);
+    const char* Span(int segment, uint32_t offset, size_t& length);
+    const Page* LoadPage(int segment, uint32_t number);
+    HistoryPos SeekInSegment(int segment, uint32_t secondOfDay);
+
+    HistoryReader(const HistoryReader&);
+    HistoryReader& operator=(const HistoryReader&);
+};
+
+#endif // HISTORY_H
@@ -1,15 +1,78 @@
 #include "IRCClient.h"
+#include "Clock.h"
+#include "HeapStats.h"
 #include <iostream>
-#include <sstream>
+#include <cstring>
+#include <errno.h>
 
 #ifdef LOCAL_TESTING
     // Dummy socket impl for local testing
     #include <unistd.h>
     #include <fcntl.h>
-    #include <errno.h>
+    #include <poll.h>
 #endif
 
-IRCClient::IRCClient() : currentState(State::Disconnected), socketFD(-1) {
+// Defaults sized so a 68030 still gets back to WaitNextEvent about once
+// per tick while a netsplit is pouring in.
+static const IRCClient::ReadBudget kDefaultReadBudget = { 16384, 200, 20000 };
+
+// Lines wait in the OutboundQueue; this only holds what the bucket has
+// released but the socket has not taken yet.
+static const size_t kSendBufferSize = 4096;
+
+// Room for every temporary a single line can produce
+static const size_t kLineArenaSize = 2048;
+
+// Stands in for a descriptor while a ByteSource is attached
+static const SocketHandle kByteSourceHandle = -2;
+
+// SocketRead() result for a hard error, as opposed to -1 for "nothing yet"
+static const int kSocketError = -2;
+
+#if defined(MSG_NOSIGNAL)
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+static const int kSendFlags = 0;
+#endif
+
+// Give up on a phase of the connect that takes longer than this
+static const uint32_t kConnectTimeoutMillis = 30000;
+static const uint32_t kRegisterTimeoutMillis = 60000;
+static const int kMaxNickRetries = 5;
+
+// Reading the clock costs a trap on the Mac, so only check every few lines
+static const unsigned kClockCheckInterval = 16;
+
+// Capabilities requested when the server offers them
+struct CapName {
+    const char* name;
+    uint8_t bit;
+};
+static const CapName kWantedCaps[] = {
+    { "server-time", IRCClient::kCapServerTime },
+    { "batch", IRCClient::kCapBatch },
+    { "message-tags", IRCClient::kCapMessageTags },
+};
+static const int kWantedCapCount = sizeof(kWantedCaps) / sizeof(kWantedCaps[0]);
+
+// Bit for one entry of a CAP list ("name" or, from CAP LS 302, "name=value")
+static uint8_t CapBit(std::string_view token) {
+    token = token.substr(0, token.find('='));
+    for (int i = 0; i < kWantedCapCount; i++) {
+        if (token == kWantedCaps[i].name) return kWantedCaps[i].bit;
+    }
+    return 0;
+}
+
+IRCClient::IRCClient() : currentState(State::Disconnected), socketFD(-1), byteSource(nullptr), caseMapping(CaseMapping::Rfc1459), serverPort(0), nickRetries(0),
+      capsOffered(0), capsEnabled(0), capNegotiating(false),
+      connectStart(0), phaseStart(0), lineArena(kLineArenaSize), interns(namePool), membership(interns),
+      netsplits(interns, membership), readBudget(kDefaultReadBudget), inputPending(false),
+      sendBuffer(kSendBufferSize), lineEventCount(0), lineEventNext(0), inLine(false), pendingLogShown(false) {
+    memset(&connectTimings, 0, sizeof(connectTimings));
+    memset(&tick, 0, sizeof(tick));
+    memset(&readStats, 0, sizeof(readStats));
+    memset(&sendStats, 0, sizeof(sendStats));
 }
 
 IRCClient::~IRCClient() {
@@ -21,179 +84,812 @@ void IRCClient::Connect(const std::string& server, int port, const std::string&
         Disconnect("Reconnecting");
     }
 
+    serverHost = server;
+    serverPort = port;
+    wantedNick = nick;
     currentNick = nick;
-    if (onLog) onLog("Connecting to " + server + "...");
+    userName = user;
+    realName = realname;
+    nickRetries = 0;
+    capsOffered = capsEnabled = 0;
+    caseMapping = CaseMapping::Rfc1459;
+    interns.SetMapping(caseMapping);
+    membership.SetCaseMapping(caseMapping);
+    memset(&connectTimings, 0, sizeof(connectTimings));
+    connectStart = phaseStart = ClockMillis();
+
+    Log({ "Connecting to ", server, "..." });
+    currentState = State::Resolving;
+#ifndef LOCAL_TESTING
+    if (!byteSource) resolver.Start(server);
+#endif
+}
 
-    if (SocketConnect(server, port)) {
-        currentState = State::Connecting;
+void IRCClient::Disconnect(const std::string& reason) {
+    if (currentState == State::Disconnected) return;
 
-        // Send registration
-        SendRaw("NICK " + nick);
-        SendRaw("USER " + user + " 0 * :" + realname);
+    if (currentState == State::Registering || currentState == State::Connected) {
+        QueueLine(OutboundQueue::kPriorityUrgent, { "QUIT :", reason });
+        FlushSend();
+    }
+    resolver.Cancel();
+    SocketClose();
+    recvBuffer.Clear();
+    netsplits.Clear();
+    membership.Clear();
+    openBatches.clear();
+    outbound.Clear();
+    sendBuffer.Clear();
+    currentState = State::Disconnected;
+    Log({ "Disconnected: ", reason });
+}
 
-        currentState = State::Connected; // Simplified for MVP (real world waits for 001)
-        if (onLog) onLog("Connected.");
-    } else {
-        if (onLog) onLog("Connection failed.");
-        currentState = State::Disconnected;
+void IRCClient::FailConnect(const std::string& reason) {
+    resolver.Cancel();
+    SocketClose();
+    recvBuffer.Clear();
+    netsplits.Clear();
+    membership.Clear();
+    openBatches.clear();
+    outbound.Clear();
+    sendBuffer.Clear();
+    currentState = State::Disconnected;
+    Log({ "Connection failed: ", reason });
+}
+
+void IRCClient::UpdateResolving() {
+    uint32_t address = 0;
+#ifndef LOCAL_TESTING
+    HostResolver::Status status = byteSource ? HostResolver::kDone : resolver.Poll(address);
+    if (status == HostResolver::kPending) {
+        if ((uint32_t)(ClockMillis() - phaseStart) >= kConnectTimeoutMillis) FailConnect("lookup timed out");
+        return;
+    }
+    if (status != HostResolver::kDone) {
+        FailConnect("unknown host " + serverHost);
+        return;
     }
+#endif
+
+    uint32_t now = ClockMillis();
+    connectTimings.resolveMillis = now - phaseStart;
+    phaseStart = now;
+
+    if (!SocketOpen(address, serverPort)) {
+        FailConnect("cannot open socket");
+        return;
+    }
+    currentState = State::Connecting;
+    UpdateConnecting();
 }
 
-void IRCClient::Disconnect(const std::string& reason) {
-    if (currentState != State::Disconnected) {
-        SendRaw("QUIT :" + reason);
-        SocketClose();
-        currentState = State::Disconnected;
-        if (onLog) onLog("Disconnected: " + reason);
+void IRCClient::UpdateConnecting() {
+    int result = SocketPollConnect();
+    if (result < 0) {
+        FailConnect("connection refused");
+        return;
     }
+    if (result == 0) {
+        if ((uint32_t)(ClockMillis() - phaseStart) >= kConnectTimeoutMillis) FailConnect("connect timed out");
+        return;
+    }
+
+    uint32_t now = ClockMillis();
+    connectTimings.tcpMillis = now - phaseStart;
+    phaseStart = now;
+    BeginRegistration();
 }
 
-void IRCClient::SendRaw(const std::string& data) {
-    if (socketFD != -1) {
-        std::string out = data + "\r\n";
-        SocketWrite(out);
-        // Debug
-        // if (onLog) onLog("-> " + data);
+void IRCClient::BeginRegistration() {
+    currentState = State::Registering;
+    // Servers without CAP answer 421 and register us anyway
+    capNegotiating = true;
+    QueueLine(OutboundQueue::kPriorityInteractive, { "CAP LS 302" });
+    QueueLine(OutboundQueue::kPriorityInteractive, { "NICK ", currentNick });
+    QueueLine(OutboundQueue::kPriorityInteractive, { "USER ", userName, " 0 * :", realName });
+}
+
+void IRCClient::SendRaw(std::string_view data, Priority priority) {
+    QueueLine(priority, { data });
+    // Debug
+    // Log({ "-> ", data });
+}
+
+void IRCClient::QueueLine(Priority priority, std::initializer_list<std::string_view> pieces) {
+    if (socketFD == -1) return;
+
+    if (!outbound.Enqueue(priority, pieces, ClockMillis())) {
+        sendStats.droppedLines++;
+        return;
     }
+    sendStats.linesQueued++;
 }
 
-void IRCClient::Update() {
-    if (currentState == State::Disconnected) return;
+// Releases whatever the flood control allows into the send buffer, then
+// writes as much of it as the socket takes in one call. Returns false on
+// a hard socket error.
+bool IRCClient::FlushSend() {
+    if (socketFD == -1) return true;
+
+    size_t before = sendBuffer.Size();
+    outbound.Pump(sendBuffer, ClockMillis());
+    sendStats.bytesQueued += sendBuffer.Size() - before;
+    if (sendBuffer.Empty()) return true;
+
+    size_t pending = sendBuffer.Size();
+    int written = SocketWrite(sendBuffer.Data(), pending);
+    sendStats.writeCalls++;
+
+    if (written < 0) return false;
+    if ((size_t)written < pending) sendStats.partialWrites++;
+    sendBuffer.Consume(written);
+    sendStats.bytesSent += written;
+    return true;
+}
 
-    char buf[1024];
-    int bytes = SocketRead(buf, sizeof(buf) - 1);
+void IRCClient::BeginUpdate() {
+    inputPending = false;
+    tick.active = false;
+
+    switch (currentState) {
+        case State::Disconnected:
+            return;
+        case State::Resolving:
+            UpdateResolving();
+            if (currentState != State::Registering) return;
+            break;
+        case State::Connecting:
+            UpdateConnecting();
+            if (currentState != State::Registering) return;
+            break;
+        case State::Registering:
+            if ((uint32_t)(ClockMillis() - phaseStart) >= kRegisterTimeoutMillis) {
+                Disconnect("Registration timed out");
+                return;
+            }
+            break;
+        case State::Connected:
+            break;
+    }
+
+    if (!FlushSend()) {
+        Disconnect("Write error");
+        return;
+    }
+
+    tick.active = true;
+    tick.budgetHit = false;
+    tick.start = ClockMicros();
+    tick.bytes = 0;
+    tick.lines = 0;
+}
+
+bool IRCClient::NextEvent(IRCEvent& event) {
+    for (;;) {
+        // The caller is done with whatever we handed out last time
+        if (pendingLogShown) {
+            pendingLog.pop_front();
+            pendingLogShown = false;
+        }
+        if (!pendingLog.empty()) {
+            event.kind = IRCEvent::kLog;
+            event.self = false;
+            event.targetId = kNoIntern;
+            event.target = event.sender = std::string_view();
+            event.text = pendingLog.front();
+            event.count = 0;
+            event.tags = IRCTags();
+            pendingLogShown = true;
+            return true;
+        }
+        if (lineEventNext < lineEventCount) {
+            event = lineEvents[lineEventNext++];
+            return true;
+        }
+        if (!tick.active) return false;
+        if (!Step()) EndUpdate();
+    }
+}
+
+// Handles one framed line, or reads from the socket if none is left.
+// False once the tick is over: drained, out of budget or disconnected.
+bool IRCClient::Step() {
+    if (currentState == State::Disconnected) return false;
+    if (tick.lines >= readBudget.maxLines) {
+        tick.budgetHit = true;
+        return false;
+    }
+
+    // Lines already framed (possibly left over from the previous tick)
+    const char* line;
+    size_t length;
+    PhaseLap lap(PhaseSample(kPhaseFraming));
+    if (recvBuffer.NextLine(line, length)) {
+        lap.Lap(kPhaseFraming);
+        if (connectTimings.firstLineMillis == 0) {
+            connectTimings.firstLineMillis = (ClockMillis() - connectStart) | 1; // 0 means "not yet"
+        }
+        ParseLine(line, length, lap);
+        tick.lines++;
+
+        if ((tick.lines % kClockCheckInterval) == 0 &&
+            (uint32_t)(ClockMicros() - tick.start) >= readBudget.maxMicros) {
+            tick.budgetHit = true;
+            return false;
+        }
+        return true;
+    }
+
+    if (tick.bytes >= readBudget.maxBytes) {
+        tick.budgetHit = true;
+        return false;
+    }
+
+    size_t avail;
+    char* dst = recvBuffer.WritePtr(avail);
+    if (avail > readBudget.maxBytes - tick.bytes) avail = readBudget.maxBytes - tick.bytes;
+    PhaseLap readLap(true);
+    int bytes = SocketRead(dst, (int)avail);
+    readLap.Lap(kPhaseSocketRead);
 
     if (bytes > 0) {
-        buf[bytes] = '\0';
-        buffer.append(buf);
-        HandleData(buffer);
-    } else if (bytes == 0) {
+        recvBuffer.Commit(bytes);
+        tick.bytes += bytes;
+        return true;
+    }
+    if (bytes == 0) {
         // Disconnected by remote
         Disconnect("Remote host closed connection");
+    } else if (bytes == kSocketError) {
+        // A reset socket stays readable; waiting for more would spin
+        Disconnect("Read error");
+    }
+    // Otherwise EWOULDBLOCK: drained
+    return false;
+}
+
+void IRCClient::EndUpdate() {
+    tick.active = false;
+
+    // A split that has gone quiet is reported now rather than with
+    // whatever line comes next
+    if (netsplits.Due(ClockMillis())) {
+        if (lineEventNext == lineEventCount) lineEventCount = lineEventNext = 0;
+        lineTags = IRCTags();
+        FlushNetsplits();
+    }
+
+    // Replies generated while dispatching (PONG etc.) go out this tick
+    if (currentState != State::Disconnected && !FlushSend()) {
+        Disconnect("Write error");
+        return;
+    }
+
+    // Every event of this tick has been delivered, so no id is in flight
+    if (interns.WantsPrune()) interns.Prune();
+
+    inputPending = tick.budgetHit;
+    if (tick.bytes == 0 && tick.lines == 0) return;
+
+    readStats.bytesLastTick = tick.bytes;
+    readStats.linesLastTick = tick.lines;
+    if (tick.bytes > readStats.maxBytesPerTick) readStats.maxBytesPerTick = tick.bytes;
+    if (tick.lines > readStats.maxLinesPerTick) readStats.maxLinesPerTick = tick.lines;
+    readStats.totalBytes += tick.bytes;
+    readStats.totalLines += tick.lines;
+    readStats.ticks++;
+    if (tick.budgetHit) readStats.budgetHits++;
+}
+
+void IRCClient::WaitForActivity(uint32_t timeoutMillis) {
+    if (timeoutMillis == 0 || socketFD == kByteSourceHandle) return;
+#ifdef LOCAL_TESTING
+    // Dummy socket never becomes readable; just don't spin
+    poll(nullptr, 0, (int)timeoutMillis);
+#elif defined(__unix__)
+    if (socketFD == -1) {
+        poll(nullptr, 0, (int)timeoutMillis);
+        return;
+    }
+    struct pollfd pfd;
+    pfd.fd = socketFD;
+    pfd.events = POLLIN;
+    if (!sendBuffer.Empty() || currentState == State::Connecting) pfd.events |= POLLOUT;
+    poll(&pfd, 1, (int)timeoutMillis);
+#else
+    (void)timeoutMillis;
+#endif
+}
+
+void IRCClient::ParseLine(const char* line, size_t length, PhaseLap& lap) {
+    HEAP_SCOPE(kHeapParseLine);
+
+    // Everything the previous line produced has been delivered by now
+    lineArena.Reset();
+    lineEventCount = lineEventNext = 0;
+
+    IRCMessageView msg;
+    if (!ParseIRCLine(line, length, msg)) return;
+    lineTags = IRCTags();
+    if (msg.tags.length) {
+        msg.Tag("time", lineTags.time);
+        msg.Tag("msgid", lineTags.msgid);
+        msg.Tag("batch", lineTags.batch);
+    }
+    lap.Lap(kPhaseParse);
+
+    inLine = true;
+    ProcessMessage(msg);
+    inLine = false;
+    lap.Lap(kPhaseDispatch);
+}
+
+// Indexed by IRCCommand; null entries are ignored
+const IRCClient::MessageHandler IRCClient::kMessageHandlers[(int)IRCCommand::Count] = {
+    nullptr,                    // Unknown
+    &IRCClient::HandlePing,     // Ping
+    nullptr,                    // Pong
+    &IRCClient::HandlePrivmsg,  // Privmsg
+    nullptr,                    // Notice
+    &IRCClient::HandleJoin,     // Join
+    &IRCClient::HandlePart,     // Part
+    &IRCClient::HandleQuit,     // Quit
+    &IRCClient::HandleNick,     // Nick
+    &IRCClient::HandleMode,     // Mode
+    nullptr,                    // Topic
+    &IRCClient::HandleKick,     // Kick
+    &IRCClient::HandleError,    // Error
+    &IRCClient::HandleCap,      // Cap
+    &IRCClient::HandleBatch,    // Batch
+    &IRCClient::HandleWelcome,  // RplWelcome
+    &IRCClient::HandleISupport, // RplISupport
+    nullptr,                    // RplTopic
+    &IRCClient::HandleNamReply, // RplNamReply
+    &IRCClient::HandleEndOfNames, // RplEndOfNames
+    nullptr,                    // RplMotd
+    nullptr,                    // RplMotdStart
+    nullptr,                    // RplEndOfMotd
+    nullptr,                    // ErrNoMotd
+    &IRCClient::HandleNicknameInUse, // ErrNicknameInUse
+    nullptr,                    // Numeric
+};
+
+void IRCClient::ProcessMessage(const IRCMessageView& msg) {
+    HEAP_SCOPE(kHeapProcessMessage);
+    // Log raw (verbose) or specific events
+    // Log({ msg.Command(), " ", msg.Param(0) });
+
+    // Queued split quits and rejoins reach the membership before any
+    // message that reads or changes it
+    if (netsplits.Pending()) {
+        switch (msg.commandId) {
+            case IRCCommand::Part:
+            case IRCCommand::Kick:
+            case IRCCommand::Nick:
+            case IRCCommand::Mode:
+            case IRCCommand::RplNamReply:
+            case IRCCommand::RplEndOfNames:
+                FlushNetsplits();
+                break;
+            default:
+                break;
+        }
+    }
+
+    MessageHandler handler = kMessageHandlers[(int)msg.commandId];
+    if (handler) (this->*handler)(msg);
+}
+
+void IRCClient::HandlePing(const IRCMessageView& msg) {
+    // Answer immediately; a bare "PING" gets a bare "PONG"
+    if (msg.paramCount > 0) {
+        QueueLine(OutboundQueue::kPriorityUrgent, { "PONG :", msg.Param(msg.paramCount - 1) });
     } else {
-        // Error or EWOULDBLOCK
+        QueueLine(OutboundQueue::kPriorityUrgent, { "PONG" });
     }
 }
 
-void IRCClient::HandleData(const std::string& data) {
-    size_t pos = 0;
-    size_t found;
+void IRCClient::HandlePrivmsg(const IRCMessageView& msg) {
+    if (msg.paramCount < 2) return;
+
+    // Nick from the prefix (nick!user@host); all views into the line. A
+    // message to us belongs to the conversation with its sender.
+    std::string_view sender = msg.PrefixNick();
+    std::string_view target = IsSelf(msg.Param(0)) ? sender : msg.Param(0);
+    IRCTarget conversation = { interns.Find(target), target };
+    Emit(IRCEvent::kMessage, conversation, sender, msg.Param(1));
+}
 
-    while ((found = buffer.find("\r\n", pos)) != std::string::npos) {
-        std::string line = buffer.substr(pos, found - pos);
-        ParseLine(line);
-        pos = found + 2;
+IRCTarget IRCClient::ChannelTarget(int id, std::string_view name) const {
+    if (id < 0) {
+        IRCTarget untracked = { interns.Find(name), name };
+        return untracked;
     }
-    buffer.erase(0, pos);
+    IRCTarget tracked = { membership.ChannelId(id), membership.ChannelName(id) };
+    return tracked;
 }
 
-void IRCClient::ParseLine(const std::string& line) {
-    if (line.empty()) return;
+bool IRCClient::IsSelf(std::string_view nick) const {
+    return IRCEquals(nick, currentNick, caseMapping);
+}
 
-    // Handle PING immediately
-    if (line.substr(0, 4) == "PING") {
-        SendRaw("PONG " + line.substr(5));
-        return;
+void IRCClient::HandleJoin(const IRCMessageView& msg) {
+    if (msg.paramCount < 1) return;
+    std::string_view channel = msg.Param(0);
+    std::string_view nick = msg.PrefixNick();
+    bool self = IsSelf(nick);
+
+    // A split's quits are settled before its rejoins are matched against it
+    if (netsplits.HasQuits()) FlushNetsplits();
+
+    // Our own JOIN starts tracking; NAMES follows to fill it in
+    int id = self ? membership.AddChannel(channel) : membership.FindChannel(channel);
+    if (!self && id >= 0 && netsplits.AddJoin(id, nick, ClockMillis())) return;
+    if (id >= 0) membership.AddMember(id, nick, 0);
+    Emit(IRCEvent::kJoin, ChannelTarget(id, channel), nick, std::string_view(), self);
+}
+
+void IRCClient::HandlePart(const IRCMessageView& msg) {
+    if (msg.paramCount < 1) return;
+    std::string_view channel = msg.Param(0);
+    std::string_view nick = msg.PrefixNick();
+    std::string_view reason = (msg.paramCount > 1) ? msg.Param(1) : std::string_view();
+    LeaveChannel(channel, nick, reason);
+}
+
+void IRCClient::HandleKick(const IRCMessageView& msg) {
+    // KICK <channel> <nick> [:reason]
+    if (msg.paramCount < 2) return;
+    std::string_view reason = (msg.paramCount > 2) ? msg.Param(2) : std::string_view();
+    LeaveChannel(msg.Param(0), msg.Param(1), lineArena.Concat({ "kicked by ", msg.PrefixNick(), ": ", reason }));
+}
+
+// Applies queued split quits and rejoins to the membership in bulk and
+// reports one summary per channel
+void IRCClient::FlushNetsplits() {
+    netsplitScratch.clear();
+    netsplits.Flush(netsplitScratch);
+    for (size_t i = 0; i < netsplitScratch.size(); i++) {
+        const NetsplitSummary& summary = netsplitScratch[i];
+        // The group's server names may be dropped by the next split
+        std::string_view servers = lineArena.Concat({ summary.servers });
+        Emit(IRCEvent::kNetsplit, ChannelTarget(summary.channel, std::string_view()), std::string_view(), servers,
+             summary.rejoined, summary.count);
+    }
+}
+
+void IRCClient::LeaveChannel(std::string_view channel, std::string_view nick, std::string_view reason) {
+    bool self = IsSelf(nick);
+    int id = membership.FindChannel(channel);
+    // Taken before RemoveChannel; the name stays interned until the tick ends
+    IRCTarget target = ChannelTarget(id, channel);
+    if (id >= 0) {
+        if (self) membership.RemoveChannel(id);
+        else membership.RemoveMember(id, nick);
     }
+    Emit(IRCEvent::kPart, target, nick, reason, self);
+}
+
+void IRCClient::HandleQuit(const IRCMessageView& msg) {
+    std::string_view nick = msg.PrefixNick();
+    std::string_view reason = (msg.paramCount > 0) ? msg.Param(0) : std::string_view();
 
-    Message msg;
-    std::stringstream ss(line);
-    std::string segment;
+    // A split: queued, reported per channel once the burst is over
+    if (NetsplitTracker::IsSplitReason(reason)) {
+        if (!netsplits.Accepts(reason)) FlushNetsplits();
+        if (netsplits.AddQuit(nick, reason, ClockMillis())) return;
+    }
 
-    // Prefix
-    if (line[0] == ':') {
-        ss >> segment;
-        msg.prefix = segment.substr(1);
+    // Only the windows that shared a channel with them hear about it
+    uint32_t mask = membership.RemoveUser(nick);
+    for (int i = 0; mask; i++, mask >>= 1) {
+        if (mask & 1) Emit(IRCEvent::kQuit, ChannelTarget(i, std::string_view()), nick, reason);
     }
+}
 
-    // Command
-    ss >> msg.command;
+void IRCClient::HandleNick(const IRCMessageView& msg) {
+    if (msg.paramCount < 1) return;
+    std::string_view oldNick = msg.PrefixNick();
+    std::string_view newNick = msg.Param(0);
+    bool self = IsSelf(oldNick);
 
-    // Params
-    while (ss >> segment) {
-        if (segment[0] == ':') {
-            std::string trailing;
-            getline(ss, trailing);
-            msg.params.push_back(segment.substr(1) + trailing);
-            break;
-        } else {
-            msg.params.push_back(segment);
+    uint32_t mask = membership.RenameUser(oldNick, newNick);
+    for (int i = 0; mask; i++, mask >>= 1) {
+        if (mask & 1) Emit(IRCEvent::kNick, ChannelTarget(i, std::string_view()), oldNick, newNick, self);
+    }
+    if (self) currentNick.assign(newNick.data(), newNick.size());
+}
+
+void IRCClient::HandleMode(const IRCMessageView& msg) {
+    // MODE <channel> <+-modes> [params...]; only prefix modes matter here
+    if (msg.paramCount < 2) return;
+    int id = membership.FindChannel(msg.Param(0));
+    if (id < 0) return;
+
+    std::string_view modes = msg.Param(1);
+    int next = 2;
+    bool adding = true;
+    for (size_t i = 0; i < modes.size(); i++) {
+        char mode = modes[i];
+        if (mode == '+' || mode == '-') {
+            adding = (mode == '+');
+            continue;
         }
+        if (!membership.ModeTakesParam(mode, adding)) continue;
+        if (next >= msg.paramCount) break;
+        std::string_view param = msg.Param(next++);
+        int bit = membership.PrefixBitForMode(mode);
+        if (bit >= 0) membership.SetMemberPrefix(id, param, bit, adding);
     }
+}
 
-    ProcessMessage(msg);
+void IRCClient::HandleNamReply(const IRCMessageView& msg) {
+    // 353 <me> <=|*|@> <channel> :[prefix]nick ...
+    if (msg.paramCount < 4) return;
+    int id = membership.FindChannel(msg.Param(2));
+    if (id >= 0) membership.AddNames(id, msg.Param(3));
 }
 
-void IRCClient::ProcessMessage(const Message& msg) {
-    // Log raw (verbose) or specific events
-    // if (onLog) onLog(msg.command + " " + (msg.params.empty() ? "" : msg.params[0]));
+void IRCClient::HandleEndOfNames(const IRCMessageView& msg) {
+    // 366 <me> <channel> :End of /NAMES list.
+    if (msg.paramCount < 2) return;
+    int id = membership.FindChannel(msg.Param(1));
+    if (id < 0) return;
+    membership.EndNames(id);
+    Emit(IRCEvent::kNames, ChannelTarget(id, std::string_view()), std::string_view(), std::string_view());
+}
+
+void IRCClient::HandleError(const IRCMessageView& msg) {
+    // Server is about to close the link; say why
+    Log({ "Server error: ", msg.Param(0) });
+}
+
+void IRCClient::HandleCap(const IRCMessageView& msg) {
+    // CAP <nick|*> <subcommand> [*] :<cap> <cap>...
+    if (msg.paramCount < 3) return;
+    std::string_view subcommand = msg.Param(1);
+    std::string_view list = msg.Param(msg.paramCount - 1);
+
+    uint8_t bits = 0, removed = 0;
+    while (!list.empty()) {
+        size_t end = list.find(' ');
+        std::string_view token = list.substr(0, end);
+        if (!token.empty() && token[0] == '-') removed |= CapBit(token.substr(1));
+        else bits |= CapBit(token);
+        if (end == std::string_view::npos) break;
+        list.remove_prefix(end + 1);
+    }
+
+    if (subcommand == "LS") {
+        capsOffered |= bits;
+        // A '*' before the list means more LS lines follow
+        if (msg.paramCount > 3 && msg.Param(2) == "*") return;
+        if (!capNegotiating) return;
+        if (!capsOffered) {
+            EndCapNegotiation();
+            return;
+        }
+        std::string request("CAP REQ :");
+        for (int i = 0; i < kWantedCapCount; i++) {
+            if (!(capsOffered & kWantedCaps[i].bit)) continue;
+            if (request.size() > 9) request += ' ';
+            request += kWantedCaps[i].name;
+        }
+        QueueLine(OutboundQueue::kPriorityInteractive, { request });
+    } else if (subcommand == "ACK") {
+        capsEnabled = (uint8_t)((capsEnabled | bits) & ~removed);
+        Log({ "Capabilities: ", msg.Param(msg.paramCount - 1) });
+        EndCapNegotiation();
+    } else if (subcommand == "NAK") {
+        EndCapNegotiation();
+    } else if (subcommand == "DEL") {
+        capsEnabled &= (uint8_t)~bits;
+    }
+}
+
+void IRCClient::EndCapNegotiation() {
+    if (!capNegotiating) return;
+    capNegotiating = false;
+    QueueLine(OutboundQueue::kPriorityInteractive, { "CAP END" });
+}
+
+void IRCClient::HandleBatch(const IRCMessageView& msg) {
+    // BATCH +ref type [params...] ... BATCH -ref. The lines in between are
+    // handled as they come; the sink hears where the batch starts and ends.
+    if (msg.paramCount < 1 || msg.Param(0).size() < 2) return;
+    std::string_view ref = msg.Param(0).substr(1);
+
+    if (msg.Param(0)[0] == '+') {
+        if (msg.paramCount < 2 || openBatches.size() == kMaxOpenBatches) return;
+        OpenBatch batch;
+        batch.ref.assign(ref.data(), ref.size());
+        batch.type.assign(msg.Param(1).data(), msg.Param(1).size());
+        std::string_view first = msg.Param(2);
+        batch.target.assign(first.data(), first.size());
+        openBatches.push_back(batch);
+        IRCTarget target = { interns.Find(first), first };
+        Emit(IRCEvent::kBatchStart, target, std::string_view(), msg.Param(1));
+        return;
+    }
+
+    for (size_t i = 0; i < openBatches.size(); i++) {
+        if (openBatches[i].ref != ref) continue;
+        // The type and target outlive the entry in the line arena
+        std::string_view type = lineArena.Concat({ openBatches[i].type });
+        std::string_view name = lineArena.Concat({ openBatches[i].target });
+        openBatches.erase(openBatches.begin() + i);
+        // A netsplit or netjoin batch is the whole burst
+        if (netsplits.Pending() && (type == "netsplit" || type == "netjoin")) FlushNetsplits();
+        IRCTarget target = { interns.Find(name), name };
+        Emit(IRCEvent::kBatchEnd, target, std::string_view(), type);
+        return;
+    }
+}
+
+void IRCClient::HandleWelcome(const IRCMessageView& msg) {
+    if (currentState != State::Registering) return;
+    // Registered, so whatever was negotiated is settled
+    capNegotiating = false;
+
+    // The server may have truncated or otherwise changed our nick
+    if (msg.paramCount > 0) currentNick.assign(msg.Param(0).data(), msg.Param(0).size());
 
-    if (msg.command == "PRIVMSG" && msg.params.size() >= 2) {
-        std::string target = msg.params[0];
-        std::string text = msg.params[1];
+    connectTimings.registerMillis = ClockMillis() - phaseStart;
+    currentState = State::Connected;
+    Log({ "Connected." });
+}
 
-        // Extract nick from prefix (nick!user@host)
-        std::string sender = msg.prefix;
-        size_t bang = sender.find('!');
-        if (bang != std::string::npos) {
-            sender = sender.substr(0, bang);
+void IRCClient::HandleISupport(const IRCMessageView& msg) {
+    // <nick> TOKEN[=value] ... :are supported by this server
+    for (int i = 1; i < msg.paramCount - 1; i++) {
+        std::string_view token = msg.Param(i);
+        if (token.compare(0, 12, "CASEMAPPING=") == 0) {
+            caseMapping = ParseCaseMapping(token.substr(12));
+            interns.SetMapping(caseMapping);
+            membership.SetCaseMapping(caseMapping);
+        } else if (token.compare(0, 7, "PREFIX=") == 0) {
+            membership.SetPrefixes(token.substr(7));
+        } else if (token.compare(0, 10, "CHANMODES=") == 0) {
+            membership.SetChannelModes(token.substr(10));
         }
+    }
+}
+
+void IRCClient::HandleNicknameInUse(const IRCMessageView& msg) {
+    // Once registered, a 433 just means a /nick attempt failed
+    if (currentState != State::Registering) return;
+
+    if (++nickRetries > kMaxNickRetries) {
+        Disconnect("Nickname in use");
+        return;
+    }
 
-        if (onMessage) onMessage(target, sender, text);
+    // nick_, nick__ ... within the classic 9-character limit, then vary
+    // the last character
+    if (currentNick.length() < 9) {
+        currentNick += '_';
+    } else {
+        currentNick[currentNick.length() - 1] = (char)('0' + nickRetries);
     }
-    else if (msg.command == "JOIN" && !msg.params.empty()) {
-        if (onJoin) onJoin(msg.params[0]);
+    // The nick the server refused, which is the last retry after the first
+    std::string_view refused = msg.Param(1);
+    Log({ refused.empty() ? std::string_view(wantedNick) : refused, " is in use, trying ", currentNick });
+    QueueLine(OutboundQueue::kPriorityInteractive, { "NICK ", currentNick });
+}
+
+void IRCClient::Emit(IRCEvent::Kind kind, IRCTarget target, std::string_view sender, std::string_view text, bool self,
+                     uint32_t count) {
+    if (lineEventCount == kMaxLineEvents) {
+        readStats.eventsDropped++;
+        return;
     }
-    else if (msg.command == "PART" && !msg.params.empty()) {
-        if (onPart) onPart(msg.params[0]);
+    IRCEvent& event = lineEvents[lineEventCount++];
+    event.kind = kind;
+    event.self = self;
+    event.targetId = target.id;
+    event.target = target.name;
+    event.sender = sender;
+    event.text = text;
+    event.count = count;
+    event.tags = lineTags;
+}
+
+// Status text. While a line is being handled it goes out with that line's
+// events, formatted in the arena; otherwise (Connect, Disconnect called
+// from the UI) it waits for the next Update().
+void IRCClient::Log(std::initializer_list<std::string_view> pieces) {
+    if (inLine) {
+        IRCTarget none = { kNoIntern, std::string_view() };
+        Emit(IRCEvent::kLog, none, std::string_view(), lineArena.Concat(pieces));
+        return;
     }
-    // Handle numeric responses for login verification if needed
+    std::string text;
+    for (std::string_view piece : pieces) text.append(piece.data(), piece.size());
+    pendingLog.push_back(text);
 }
 
-void IRCClient::Join(const std::string& channel) {
-    SendRaw("JOIN " + channel);
+void IRCClient::Join(std::string_view channel) {
+    QueueLine(OutboundQueue::kPriorityInteractive, { "JOIN ", channel });
 }
 
-void IRCClient::Part(const std::string& channel) {
-    SendRaw("PART " + channel);
+void IRCClient::Part(std::string_view channel) {
+    QueueLine(OutboundQueue::kPriorityInteractive, { "PART ", channel });
 }
 
-void IRCClient::PrivMsg(const std::string& target, const std::string& message) {
-    SendRaw("PRIVMSG " + target + " :" + message);
+void IRCClient::PrivMsg(std::string_view target, std::string_view message, Priority priority) {
+    QueueLine(priority, { "PRIVMSG ", target, " :", message });
 }
 
 // Platform Sockets
-bool IRCClient::SocketConnect(const std::string& host, int port) {
+
+// Creates a non-blocking socket and starts the TCP handshake.
+// 'address' is IPv4 in network byte order.
+bool IRCClient::SocketOpen(uint32_t address, int port) {
+    if (byteSource) {
+        socketFD = kByteSourceHandle;
+        return true;
+    }
 #ifdef LOCAL_TESTING
     // Dummy
+    (void)address;
+    (void)port;
     socketFD = 1;
     return true;
 #else
-    struct sockaddr_in serv_addr;
-    struct hostent *server;
-
     socketFD = socket(AF_INET, SOCK_STREAM, 0);
-    if (socketFD < 0) return false;
+    if (socketFD < 0) {
+        socketFD = -1;
+        return false;
+    }
 
-    server = gethostbyname(host.c_str());
-    if (server == NULL) return false;
+    // Non-blocking before connect() so the handshake never stalls the UI
+    fcntl(socketFD, F_SETFL, fcntl(socketFD, F_GETFL, 0) | O_NONBLOCK);
+#if defined(SO_NOSIGPIPE)
+    // No MSG_NOSIGNAL here; ask the socket instead
+    int noSigPipe = 1;
+    setsockopt(socketFD, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
 
-    memset((char *)&serv_addr, 0, sizeof(serv_addr));
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
-    memcpy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
+    serv_addr.sin_addr.s_addr = address;
     serv_addr.sin_port = htons(port);
 
-    if (connect(socketFD, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+    if (connect(socketFD, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0 && errno != EINPROGRESS) {
+        SocketClose();
         return false;
     }
-
-    // Set non-blocking
-    fcntl(socketFD, F_SETFL, O_NONBLOCK);
     return true;
 #endif
 }
 
+// 1 once the handshake has completed, 0 while in progress, -1 on failure
+int IRCClient::SocketPollConnect() {
+    if (byteSource) return 1;
+#ifdef LOCAL_TESTING
+    return 1;
+#else
+    if (socketFD == -1) return -1;
+
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(socketFD, &writable);
+    struct timeval noWait = { 0, 0 };
+    if (select(socketFD + 1, nullptr, &writable, nullptr, &noWait) <= 0) return 0;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(socketFD, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) return -1;
+    return 1;
+#endif
+}
+
 void IRCClient::SocketClose() {
+    if (socketFD == kByteSourceHandle) {
+        socketFD = -1;
+        return;
+    }
 #ifndef LOCAL_TESTING
     if (socketFD != -1) {
         close(socketFD);
@@ -202,20 +898,30 @@ void IRCClient::SocketClose() {
 #endif
 }
 
+// Returns bytes read, 0 if the peer closed, -1 if nothing is waiting or
+// kSocketError on a hard error
 int IRCClient::SocketRead(char* buf, int maxlen) {
+    if (socketFD == kByteSourceHandle) return byteSource->Read(buf, maxlen);
 #ifdef LOCAL_TESTING
     return -1; // No data in test
 #else
     if (socketFD == -1) return -1;
-    return recv(socketFD, buf, maxlen, 0);
+    int received = recv(socketFD, buf, maxlen, 0);
+    if (received < 0 && errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR) return kSocketError;
+    return received;
 #endif
 }
 
-int IRCClient::SocketWrite(const std::string& data) {
+// Returns bytes accepted (0 if the socket would block) or -1 on error
+int IRCClient::SocketWrite(const char* data, size_t length) {
+    if (socketFD == kByteSourceHandle) return byteSource->Write(data, length);
 #ifdef LOCAL_TESTING
-    return data.length();
+    return (int)length;
 #else
     if (socketFD == -1) return -1;
-    return send(socketFD, data.c_str(), data.length(), 0);
+    // A peer that closes mid-flush is a write error, not a SIGPIPE
+    int sent = send(socketFD, data, length, kSendFlags);
+    if (sent < 0 && (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)) return 0;
+    return sent;
 #endif
 }
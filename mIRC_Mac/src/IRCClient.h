@@ -3,34 +3,102 @@
 
 #include <string>
 #include <vector>
-#include <functional>
-#include <queue>
+#include <deque>
+
+#include "IRCParser.h"
+#include "LineBuffer.h"
+#include "SendBuffer.h"
+#include "OutboundQueue.h"
+#include "Resolver.h"
+#include "CaseMap.h"
+#include "Arena.h"
+#include "InternTable.h"
+#include "Membership.h"
+#include "Netsplit.h"
+#include "PhaseStats.h"
+#include "IRCEvents.h"
 
 // Forward declaration for platform specific socket
 #ifdef LOCAL_TESTING
     typedef int SocketHandle;
 #else
     #include <sys/socket.h>
+    #include <sys/select.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <unistd.h>
     #include <netdb.h>
     #include <fcntl.h>
+    #if defined(__unix__)
+        #include <poll.h>
+    #endif
     typedef int SocketHandle;
 #endif
 
+// Replaces the socket, e.g. to replay a recorded session. Read() returns
+// bytes read, 0 at end of stream or -1 if nothing is available yet;
+// Write() returns bytes accepted (0 if it would block) or -1 on error.
+class ByteSource {
+public:
+    virtual ~ByteSource() {}
+    virtual int Read(char* buf, int maxlen) = 0;
+    virtual int Write(const char* data, size_t length) = 0;
+};
+
 class IRCClient {
 public:
+    // Connect() starts at Resolving; Update() drives the rest without
+    // ever blocking.
     enum class State {
         Disconnected,
-        Connecting,
+        Resolving,    // host name lookup in flight
+        Connecting,   // TCP handshake in flight (EINPROGRESS)
+        Registering,  // NICK/USER sent, waiting for 001
         Connected
     };
 
-    struct Message {
-        std::string prefix;
-        std::string command;
-        std::vector<std::string> params;
+    // Milliseconds spent in each connect phase, 0 until it completes
+    struct ConnectTimings {
+        uint32_t resolveMillis;
+        uint32_t tcpMillis;
+        uint32_t registerMillis;
+        uint32_t firstLineMillis;  // Connect() to the first line received
+    };
+
+    // Caps on how much work one Update() call may do before returning to
+    // the event loop. Whichever limit is reached first ends the tick.
+    struct ReadBudget {
+        size_t maxBytes;     // bytes pulled from the socket
+        unsigned maxLines;   // lines parsed and dispatched
+        uint32_t maxMicros;  // wall time spent in Update()
+    };
+
+    struct ReadStats {
+        size_t bytesLastTick;
+        unsigned linesLastTick;
+        size_t maxBytesPerTick;
+        unsigned maxLinesPerTick;
+        unsigned long totalBytes;
+        unsigned long totalLines;
+        unsigned long ticks;        // Update() calls that did any work
+        unsigned long budgetHits;   // ticks cut short by the budget
+        unsigned long eventsDropped; // past kMaxLineEvents; should stay 0
+    };
+
+    // IRCv3 capabilities asked for with CAP REQ during registration
+    enum Capability : uint8_t {
+        kCapServerTime = 0x01,
+        kCapBatch = 0x02,
+        kCapMessageTags = 0x04
+    };
+
+    struct SendStats {
+        unsigned long linesQueued;
+        unsigned long bytesQueued;   // released by flood control to the socket
+        unsigned long bytesSent;
+        unsigned long writeCalls;    // send() syscalls actually made
+        unsigned long partialWrites; // send() accepted less than offered
+        unsigned long droppedLines;  // did not fit in the outbound queue
     };
 
     IRCClient();
@@ -38,39 +106,192 @@ public:
 
     void Connect(const std::string& server, int port, const std::string& nick, const std::string& user, const std::string& realname);
     void Disconnect(const std::string& reason);
-    void SendRaw(const std::string& data);
+    typedef OutboundQueue::Priority Priority;
+
+    // Queues one command (CRLF is added). Goes out from Update() as the
+    // flood control allows; PONG/QUIT are always sent first.
+    void SendRaw(std::string_view data, Priority priority = OutboundQueue::kPriorityInteractive);
 
-    // Non-blocking update loop to be called from WaitNextEvent
-    void Update();
+    // Non-blocking update loop to be called from WaitNextEvent. Reads and
+    // dispatches until the socket would block or the budget runs out,
+    // handing each event straight to 'sink' (see IRCEvents.h).
+    template <class Sink>
+    void Update(Sink& sink) {
+        IRCEvent event;
+        BeginUpdate();
+        while (NextEvent(event)) DeliverIRCEvent(sink, event);
+    }
+
+    // The non-template half of Update(): BeginUpdate() runs the connect
+    // state machine and flushes output, then NextEvent() reads, frames and
+    // handles lines until it has an event to report. It returns false once
+    // the socket is drained or the budget is spent. Each event's views are
+    // valid until the next call.
+    void BeginUpdate();
+    bool NextEvent(IRCEvent& event);
+
+    // Route all socket I/O through 'source' (null restores the socket).
+    // Takes effect at the next Connect().
+    void SetByteSource(ByteSource* source) { byteSource = source; }
+
+    // Blocks until the socket is readable (or writable while output is
+    // pending) or the timeout expires. On the Mac, WaitNextEvent does the
+    // sleeping and this returns immediately.
+    void WaitForActivity(uint32_t timeoutMillis);
+
+    void SetReadBudget(const ReadBudget& budget) { readBudget = budget; }
+    const ReadStats& GetReadStats() const { return readStats; }
+    const SendStats& GetSendStats() const { return sendStats; }
+    // True when the last Update() stopped on its budget with input left over
+    bool HasPendingInput() const { return inputPending; }
 
     State GetState() const { return currentState; }
+    const std::string& GetNick() const { return currentNick; }
+    // From ISUPPORT CASEMAPPING; rfc1459 until the server says otherwise
+    CaseMapping GetCaseMapping() const { return caseMapping; }
+    const ConnectTimings& GetConnectTimings() const { return connectTimings; }
+    // Capability bits the server acknowledged
+    uint8_t GetCapabilities() const { return capsEnabled; }
+    // Batches started and not yet ended
+    size_t OpenBatchCount() const { return openBatches.size(); }
 
     // Commands
-    void Join(const std::string& channel);
-    void Part(const std::string& channel);
-    void PrivMsg(const std::string& target, const std::string& message);
+    void Join(std::string_view channel);
+    void Part(std::string_view channel);
+    void PrivMsg(std::string_view target, std::string_view message,
+                 Priority priority = OutboundQueue::kPriorityInteractive);
+
+    // Outbound scheduling
+    void SetFloodControl(const OutboundQueue::FloodControl& control) { outbound.SetFloodControl(control); }
+    const OutboundQueue& GetOutboundQueue() const { return outbound; }
+    bool HasQueuedOutput() const { return !outbound.Empty() || !sendBuffer.Empty(); }
 
-    // Callbacks
-    std::function<void(const std::string&)> onLog; // Raw log or status messages
-    std::function<void(const std::string& channel, const std::string& user, const std::string& msg)> onMessage;
-    std::function<void(const std::string& channel)> onJoin;
-    std::function<void(const std::string& channel)> onPart;
+    // Per-line scratch memory, reset before the next line is handled.
+    // Sinks may use it for formatting; nothing in it survives the event.
+    LineArena& GetLineArena() { return lineArena; }
+    // Session-wide storage for nicks and channel names
+    NamePool& GetNamePool() { return namePool; }
+    // Nicks and channel names as small integer ids (see InternTable.h)
+    InternTable& GetInterns() { return interns; }
+    // Channels we are in and who else is there
+    const Membership& GetMembership() const { return membership; }
+    // Recent netsplits, for listing who left
+    const NetsplitTracker& GetNetsplits() const { return netsplits; }
 
 private:
     State currentState;
     SocketHandle socketFD;
+    ByteSource* byteSource;
     std::string currentNick;
-    std::string buffer; // Receive buffer
+    CaseMapping caseMapping;
+
+    // Connect state machine
+    HostResolver resolver;
+    std::string serverHost;
+    int serverPort;
+    std::string userName;
+    std::string realName;
+    std::string wantedNick;
+    int nickRetries;
+    uint8_t capsOffered;  // by CAP LS, possibly over several lines
+    uint8_t capsEnabled;
+    bool capNegotiating;  // CAP END still to be sent
+    uint32_t connectStart;
+    uint32_t phaseStart;
+    ConnectTimings connectTimings;
+    LineBuffer recvBuffer;
+    LineArena lineArena;
+    NamePool namePool;
+    InternTable interns;
+    Membership membership;
+    NetsplitTracker netsplits;
+    std::vector<NetsplitSummary> netsplitScratch;
+    ReadBudget readBudget;
+    ReadStats readStats;
+    bool inputPending;
+    OutboundQueue outbound;
+    SendBuffer sendBuffer;
+    SendStats sendStats;
+
+    // Progress of the Update() in flight
+    struct Tick {
+        bool active;
+        bool budgetHit;
+        uint32_t start;
+        size_t bytes;
+        unsigned lines;
+    };
+    Tick tick;
+
+    // Events produced by the line being handled, and status text produced
+    // outside of one (connect, disconnect) waiting for the next Update()
+    // (a QUIT or NICK yields one per shared channel; a netsplit flushed
+    // ahead of a line adds a summary per channel for the newest split's
+    // quits, and one per channel and remembered split for rejoins)
+    static const int kMaxLineEvents = (2 + (int)NetsplitTracker::kMaxGroups) * Membership::kMaxChannels + 2;
+    IRCEvent lineEvents[kMaxLineEvents];
+    int lineEventCount;
+    int lineEventNext;
+    bool inLine;
+    std::deque<std::string> pendingLog;
+    bool pendingLogShown;
+    IRCTags lineTags;     // of the line being handled
+
+    // BATCH +ref ... until BATCH -ref; more than this are not tracked
+    static const size_t kMaxOpenBatches = 8;
+    struct OpenBatch {
+        std::string ref;
+        std::string type;
+        std::string target;  // first parameter, if any
+    };
+    std::vector<OpenBatch> openBatches;
+
+    bool Step();
+    void EndUpdate();
+    void Emit(IRCEvent::Kind kind, IRCTarget target, std::string_view sender, std::string_view text,
+              bool self = false, uint32_t count = 0);
+    void Log(std::initializer_list<std::string_view> pieces);
+    void UpdateResolving();
+    void UpdateConnecting();
+    void BeginRegistration();
+    void FailConnect(const std::string& reason);
+    void ParseLine(const char* line, size_t length, PhaseLap& lap);
+    void ProcessMessage(const IRCMessageView& msg);
 
-    void HandleData(const std::string& data);
-    void ParseLine(const std::string& line);
-    void ProcessMessage(const Message& msg);
+    // Dispatch table targets, one per IRCCommand
+    typedef void (IRCClient::*MessageHandler)(const IRCMessageView& msg);
+    static const MessageHandler kMessageHandlers[(int)IRCCommand::Count];
+    void HandlePing(const IRCMessageView& msg);
+    void HandlePrivmsg(const IRCMessageView& msg);
+    void HandleJoin(const IRCMessageView& msg);
+    void HandlePart(const IRCMessageView& msg);
+    void HandleKick(const IRCMessageView& msg);
+    void HandleQuit(const IRCMessageView& msg);
+    void HandleNick(const IRCMessageView& msg);
+    void HandleMode(const IRCMessageView& msg);
+    void HandleNamReply(const IRCMessageView& msg);
+    void HandleEndOfNames(const IRCMessageView& msg);
+    void FlushNetsplits();
+    void LeaveChannel(std::string_view channel, std::string_view nick, std::string_view reason);
+    bool IsSelf(std::string_view nick) const;
+    // Event target for a channel: its tracked id if 'id' >= 0, else looked up
+    IRCTarget ChannelTarget(int id, std::string_view name) const;
+    void HandleError(const IRCMessageView& msg);
+    void HandleCap(const IRCMessageView& msg);
+    void HandleBatch(const IRCMessageView& msg);
+    void EndCapNegotiation();
+    void HandleWelcome(const IRCMessageView& msg);
+    void HandleISupport(const IRCMessageView& msg);
+    void HandleNicknameInUse(const IRCMessageView& msg);
+    void QueueLine(Priority priority, std::initializer_list<std::string_view> pieces);
+    bool FlushSend();
 
     // Platform agnostic socket helpers
-    bool SocketConnect(const std::string& host, int port);
+    bool SocketOpen(uint32_t address, int port);
+    int SocketPollConnect();
     void SocketClose();
     int SocketRead(char* buf, int maxlen);
-    int SocketWrite(const std::string& data);
+    int SocketWrite(const char* data, size_t length);
 };
 
 #endif // IRC_CLIENT_H
@@ -0,0 +1,70 @@
+#include "IRCCommand.h"
+#include <cstring>
+
+static IRCCommand LookupNumeric(uint16_t numeric) {
+    switch (numeric) {
+        case 1:   return IRCCommand::RplWelcome;
+        case 5:   return IRCCommand::RplISupport;
+        case 332: return IRCCommand::RplTopic;
+        case 353: return IRCCommand::RplNamReply;
+        case 366: return IRCCommand::RplEndOfNames;
+        case 372: return IRCCommand::RplMotd;
+        case 375: return IRCCommand::RplMotdStart;
+        case 376: return IRCCommand::RplEndOfMotd;
+        case 422: return IRCCommand::ErrNoMotd;
+        case 433: return IRCCommand::ErrNicknameInUse;
+        default:  return IRCCommand::Numeric;
+    }
+}
+
+static inline bool Is(const char* s, const char* word, size_t length) {
+    return memcmp(s, word, length) == 0;
+}
+
+// Length and the first letter (second for the three 4-letter P words)
+// pick at most one candidate, so a single memcmp decides the match.
+IRCCommand LookupIRCCommand(std::string_view command, uint16_t& numeric) {
+    numeric = 0;
+    const char* s = command.data();
+    size_t length = command.size();
+
+    if (length == 3 &&
+        (unsigned)(s[0] - '0') < 10 && (unsigned)(s[1] - '0') < 10 && (unsigned)(s[2] - '0') < 10) {
+        numeric = (uint16_t)((s[0] - '0') * 100 + (s[1] - '0') * 10 + (s[2] - '0'));
+        return LookupNumeric(numeric);
+    }
+
+    switch (length) {
+        case 3:
+            if (s[0] == 'C' && Is(s, "CAP", 3)) return IRCCommand::Cap;
+            break;
+        case 4:
+            switch (s[0]) {
+                case 'P':
+                    switch (s[1]) {
+                        case 'I': if (Is(s, "PING", 4)) return IRCCommand::Ping; break;
+                        case 'O': if (Is(s, "PONG", 4)) return IRCCommand::Pong; break;
+                        case 'A': if (Is(s, "PART", 4)) return IRCCommand::Part; break;
+                    }
+                    break;
+                case 'J': if (Is(s, "JOIN", 4)) return IRCCommand::Join; break;
+                case 'Q': if (Is(s, "QUIT", 4)) return IRCCommand::Quit; break;
+                case 'N': if (Is(s, "NICK", 4)) return IRCCommand::Nick; break;
+                case 'M': if (Is(s, "MODE", 4)) return IRCCommand::Mode; break;
+                case 'K': if (Is(s, "KICK", 4)) return IRCCommand::Kick; break;
+            }
+            break;
+        case 5:
+            if (s[0] == 'T' && Is(s, "TOPIC", 5)) return IRCCommand::Topic;
+            if (s[0] == 'E' && Is(s, "ERROR", 5)) return IRCCommand::Error;
+            if (s[0] == 'B' && Is(s, "BATCH", 5)) return IRCCommand::Batch;
+            break;
+        case 6:
+            if (s[0] == 'N' && Is(s, "NOTICE", 6)) return IRCCommand::Notice;
+            break;
+        case 7:
+            if (s[0] == 'P' && Is(s, "PRIVMSG", 7)) return IRCCommand::Privmsg;
+            break;
+    }
+    return IRCCommand::Unknown;
+}
@@ -0,0 +1,47 @@
+#ifndef IRC_COMMAND_H
+#define IRC_COMMAND_H
+
+#include <cstdint>
+#include <string_view>
+
+// Commands and numerics the client acts on. Anything else maps to
+// Unknown (words) or Numeric (3-digit replies), so dispatch is a single
+// table index regardless of how many entries this grows to.
+enum class IRCCommand : uint8_t {
+    Unknown = 0,
+    Ping,
+    Pong,
+    Privmsg,
+    Notice,
+    Join,
+    Part,
+    Quit,
+    Nick,
+    Mode,
+    Topic,
+    Kick,
+    Error,
+    Cap,
+    Batch,
+
+    // Numerics
+    RplWelcome,       // 001
+    RplISupport,      // 005
+    RplTopic,         // 332
+    RplNamReply,      // 353
+    RplEndOfNames,    // 366
+    RplMotd,          // 372
+    RplMotdStart,     // 375
+    RplEndOfMotd,     // 376
+    ErrNoMotd,        // 422
+    ErrNicknameInUse, // 433
+    Numeric,          // any other 3-digit reply
+
+    Count
+};
+
+// Classifies a command word. 'numeric' receives the reply number for
+// 3-digit commands and 0 otherwise.
+IRCCommand LookupIRCCommand(std::string_view command, uint16_t& numeric);
+
+#endif // IRC_COMMAND_H
@@ -0,0 +1,110 @@
+#ifndef IRC_EVENTS_H
+#define IRC_EVENTS_H
+
+#include "InternTable.h"
+#include <string_view>
+
+// The conversation an event belongs to: a channel, or the other side of
+// a private chat. 'id' is its InternId, kNoIntern when the session has
+// never interned the name (so nothing can be keyed by it yet).
+struct IRCTarget {
+    InternId id;
+    std::string_view name;
+};
+
+// IRCv3 tags of the line an event came from, raw views into it; empty
+// when the server sent none (or the capability is off)
+struct IRCTags {
+    std::string_view time;   // server-time, UTC: ParseIRCServerTime()
+    std::string_view msgid;
+    std::string_view batch;  // reference of the batch the line is part of
+};
+
+// What IRCClient reports to the UI. Views point into the receive buffer
+// or the line arena and stay valid only until the next event is pulled.
+struct IRCEvent {
+    enum Kind {
+        kNone,
+        kLog,      // text: status line for the status window
+        kMessage,  // target (channel, or sender for private messages), sender, text
+        kJoin,     // target channel, sender nick
+        kPart,     // target channel, sender nick, text reason (also KICK)
+        kQuit,     // target channel, sender nick, text reason; one per
+                   // channel the nick shared with us
+        kNick,     // target channel, sender old nick, text new nick; ditto
+        kNames,    // target channel: its member list has been (re)loaded
+        kBatchStart, // text batch type (netsplit, netjoin, chathistory...),
+                     // target its first parameter if any
+        kBatchEnd,   // text batch type, target as at the start; every
+                     // line of it has been delivered
+        kNetsplit    // target channel, text "server1 server2", count users
+                     // who left in the split (or, with self, rejoined)
+    };
+
+    Kind kind;
+    bool self;     // Join/Part/Nick: the nick is ours; Netsplit: rejoin
+    InternId targetId;
+    std::string_view target;
+    std::string_view sender;
+    std::string_view text;
+    uint32_t count;
+    IRCTags tags;
+};
+
+// A sink is any class with these members; IRCClient::Update<Sink>() binds
+// to them at compile time, so delivery is a switch and direct calls:
+//
+//   void OnIRCLog(std::string_view text);
+//   void OnIRCMessage(IRCTarget target, std::string_view sender, std::string_view text, const IRCTags& tags);
+//   void OnIRCJoin(IRCTarget channel, std::string_view nick, bool self);
+//   void OnIRCPart(IRCTarget channel, std::string_view nick, std::string_view reason, bool self);
+//   void OnIRCQuit(IRCTarget channel, std::string_view nick, std::string_view reason);
+//   void OnIRCNick(IRCTarget channel, std::string_view oldNick, std::string_view newNick, bool self);
+//   void OnIRCNames(IRCTarget channel);
+//   void OnIRCBatchStart(std::string_view type, IRCTarget target);
+//   void OnIRCBatchEnd(std::string_view type, IRCTarget target);
+//   void OnIRCNetsplit(IRCTarget channel, std::string_view servers, uint32_t count, bool rejoined);
+//
+// Batches nest, and the events between a start and its end arrive over
+// as many Update() calls as the read budget needs; a sink that holds its
+// redraws until the end draws each batch once.
+template <class Sink>
+inline void DeliverIRCEvent(Sink& sink, const IRCEvent& event) {
+    IRCTarget target = { event.targetId, event.target };
+    switch (event.kind) {
+        case IRCEvent::kLog:
+            sink.OnIRCLog(event.text);
+            break;
+        case IRCEvent::kMessage:
+            sink.OnIRCMessage(target, event.sender, event.text, event.tags);
+            break;
+        case IRCEvent::kJoin:
+            sink.OnIRCJoin(target, event.sender, event.self);
+            break;
+        case IRCEvent::kPart:
+            sink.OnIRCPart(target, event.sender, event.text, event.self);
+            break;
+        case IRCEvent::kQuit:
+            sink.OnIRCQuit(target, event.sender, event.text);
+            break;
+        case IRCEvent::kNick:
+            sink.OnIRCNick(target, event.sender, event.text, event.self);
+            break;
+        case IRCEvent::kNames:
+            sink.OnIRCNames(target);
+            break;
+        case IRCEvent::kBatchStart:
+            sink.OnIRCBatchStart(event.text, target);
+            break;
+        case IRCEvent::kBatchEnd:
+            sink.OnIRCBatchEnd(event.text, target);
+            break;
+        case IRCEvent::kNetsplit:
+            sink.OnIRCNetsplit(target, event.text, event.count, event.self);
+            break;
+        case IRCEvent::kNone:
+            break;
+    }
+}
+
+#endif // IRC_EVENTS_H
@@ -0,0 +1,138 @@
+#include "IRCFormat.h"
+#include <cstring>
+
+// What a byte does, for every byte below 0x20; everything else is text
+enum FormatAction : uint8_t {
+    kActText,
+    kActToggle,
+    kActColor,
+    kActHexColor,
+    kActReset
+};
+
+static const uint8_t kAction[32] = {
+    kActText,   kActText,   kActToggle, kActColor,  kActHexColor, kActText,   kActText,   kActText,    // 00-07
+    kActText,   kActText,   kActText,   kActText,   kActText,     kActText,   kActText,   kActReset,   // 08-0F
+    kActText,   kActToggle, kActText,   kActText,   kActText,     kActText,   kActToggle, kActText,    // 10-17
+    kActText,   kActText,   kActText,   kActText,   kActText,     kActToggle, kActToggle, kActToggle,  // 18-1F
+};
+
+// The flag a kActToggle byte flips
+static const uint8_t kToggleFlag[32] = {
+    0, 0, kStyleBold, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, kStyleMonospace, 0, 0, 0, 0, kStyleReverse, 0,
+    0, 0, 0, 0, 0, kStyleItalic, kStyleStrike, kStyleUnderline,
+};
+
+static inline bool IsText(uint8_t c) {
+    return c >= 0x20 || kAction[c] == kActText;
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool IsHex(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Index of the first byte at or after 'i' below 0x20, four bytes at a
+// time; most lines have none. A hit may be a false one, so the bytes
+// after it are checked one by one.
+static inline size_t SkipPrintable(const char* text, size_t length, size_t i) {
+    while (i + 4 <= length) {
+        uint32_t word;
+        memcpy(&word, text + i, 4);
+        if ((word - 0x20202020u) & ~word & 0x80808080u) break;
+        i += 4;
+    }
+    while (i < length && (uint8_t)text[i] >= 0x20) i++;
+    return i;
+}
+
+// Up to two digits at text[i]; -1 if there are none
+static int ReadColor(const char* text, size_t length, size_t& i) {
+    if (i >= length || !IsDigit(text[i])) return -1;
+    int value = text[i++] - '0';
+    if (i < length && IsDigit(text[i])) value = value * 10 + (text[i++] - '0');
+    return value;
+}
+
+size_t DecodeIRCFormatting(char* text, size_t length, StyleRun* runs, size_t maxRuns, size_t& runCount) {
+    runCount = 0;
+    uint8_t flags = 0, fg = kColorDefault, bg = kColorDefault;
+    // What the text written so far is styled as
+    uint8_t shownFlags = 0, shownFg = kColorDefault, shownBg = kColorDefault;
+
+    size_t in = 0, out = 0;
+    while (in < length) {
+        uint8_t c = (uint8_t)text[in];
+        if (IsText(c)) {
+            size_t from = in;
+            for (;;) {
+                in = SkipPrintable(text, length, in);
+                if (in == length || !IsText((uint8_t)text[in])) break;
+                in++;
+            }
+
+            // A run starts only where text actually changes style
+            if ((flags != shownFlags || fg != shownFg || bg != shownBg) && runCount < maxRuns) {
+                StyleRun& run = runs[runCount++];
+                run.start[0] = (uint8_t)(out >> 8);
+                run.start[1] = (uint8_t)out;
+                run.flags = flags;
+                run.fg = fg;
+                run.bg = bg;
+                shownFlags = flags;
+                shownFg = fg;
+                shownBg = bg;
+            }
+            if (out != from) memmove(text + out, text + from, in - from);
+            out += in - from;
+            continue;
+        }
+
+        in++;
+        switch (kAction[c]) {
+            case kActToggle:
+                flags ^= kToggleFlag[c];
+                break;
+            case kActColor: {
+                // ^C alone resets both colours; ^Cfg and ^Cfg,bg set them
+                int newFg = ReadColor(text, length, in);
+                if (newFg < 0) {
+                    fg = bg = kColorDefault;
+                    break;
+                }
+                fg = (uint8_t)newFg;
+                if (in + 1 < length && text[in] == ',' && IsDigit(text[in + 1])) {
+                    in++;
+                    bg = (uint8_t)ReadColor(text, length, in);
+                }
+                break;
+            }
+            case kActHexColor: {
+                // ^D RRGGBB[,RRGGBB]: beyond a 16-colour palette, so shown
+                // in the default colours
+                size_t digits = 0;
+                while (digits < 6 && in + digits < length && IsHex(text[in + digits])) digits++;
+                if (digits == 6) {
+                    in += 6;
+                    if (in < length && text[in] == ',') {
+                        size_t more = 0;
+                        while (more < 6 && in + 1 + more < length && IsHex(text[in + 1 + more])) more++;
+                        if (more == 6) in += 7;
+                    }
+                }
+                fg = bg = kColorDefault;
+                break;
+            }
+            case kActReset:
+                flags = 0;
+                fg = bg = kColorDefault;
+                break;
+        }
+    }
+    return out;
+}
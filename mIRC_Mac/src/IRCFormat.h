@@ -0,0 +1,43 @@
+#ifndef IRC_FORMAT_H
+#define IRC_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// mIRC formatting: control codes inside message text that toggle bold,
+// italic, underline, strikethrough, monospace and reverse, set colours
+// (^C fg[,bg], 0-98 with 99 for the default) or reset everything (^O).
+enum : uint8_t {
+    kStyleBold = 0x01,
+    kStyleItalic = 0x02,
+    kStyleUnderline = 0x04,
+    kStyleStrike = 0x08,
+    kStyleMonospace = 0x10,
+    kStyleReverse = 0x20
+};
+
+const uint8_t kColorDefault = 99;
+// Runs kept per line; later codes are still stripped but the style stops
+// changing
+const size_t kMaxStyleRuns = 32;
+
+// Style from 'Start()' up to the next run or the end of the line; text
+// before the first run is unstyled. Five bytes with no alignment, so runs
+// can be packed straight after a line's text in scrollback.
+struct StyleRun {
+    uint8_t start[2];  // big-endian offset into the plain text
+    uint8_t flags;
+    uint8_t fg;
+    uint8_t bg;
+
+    uint16_t Start() const { return (uint16_t)(start[0] << 8 | start[1]); }
+    bool IsDefault() const { return flags == 0 && fg == kColorDefault && bg == kColorDefault; }
+};
+
+// Strips the control codes from text[0, length) in place and describes
+// the styling as runs. One pass, driven by a table of what each control
+// byte does; a line without codes is only scanned. Returns the plain
+// length.
+size_t DecodeIRCFormatting(char* text, size_t length, StyleRun* runs, size_t maxRuns, size_t& runCount);
+
+#endif // IRC_FORMAT_H
@@ -0,0 +1,111 @@
+#include "IRCParser.h"
+
+std::string_view IRCMessageView::PrefixNick() const {
+    std::string_view p = Prefix();
+    size_t end = p.find_first_of("!@");
+    return (end == std::string_view::npos) ? p : p.substr(0, end);
+}
+
+bool IRCMessageView::Tag(std::string_view key, std::string_view& value) const {
+    // key[=value] pairs separated by ';'
+    std::string_view rest = Tags();
+    while (!rest.empty()) {
+        size_t end = rest.find(';');
+        std::string_view tag = rest.substr(0, end);
+        if (tag.size() >= key.size() && tag.compare(0, key.size(), key) == 0 &&
+            (tag.size() == key.size() || tag[key.size()] == '=')) {
+            value = tag.substr(tag.size() == key.size() ? key.size() : key.size() + 1);
+            return true;
+        }
+        if (end == std::string_view::npos) break;
+        rest.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+static bool ReadNumber(std::string_view text, size_t at, size_t digits, int& out) {
+    if (at + digits > text.size()) return false;
+    out = 0;
+    for (size_t i = at; i < at + digits; i++) {
+        if ((unsigned)(text[i] - '0') >= 10) return false;
+        out = out * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+bool ParseIRCServerTime(std::string_view value, IRCServerTime& out) {
+    // YYYY-MM-DDThh:mm:ss, then optional fraction and 'Z'
+    return value.size() >= 19 && value[4] == '-' && value[7] == '-' && value[10] == 'T' &&
+           value[13] == ':' && value[16] == ':' &&
+           ReadNumber(value, 0, 4, out.year) && ReadNumber(value, 5, 2, out.month) &&
+           ReadNumber(value, 8, 2, out.day) && ReadNumber(value, 11, 2, out.hour) &&
+           ReadNumber(value, 14, 2, out.minute) && ReadNumber(value, 17, 2, out.second);
+}
+
+bool ParseIRCLine(const char* line, size_t length, IRCMessageView& out) {
+    out.base = line;
+    out.tags.offset = 0;
+    out.tags.length = 0;
+    out.prefix.offset = 0;
+    out.prefix.length = 0;
+    out.paramCount = 0;
+    out.command.offset = 0;
+    out.command.length = 0;
+    out.commandId = IRCCommand::Unknown;
+    out.numeric = 0;
+
+    if (length > 0xFFFF) length = 0xFFFF;
+    const size_t end = length;
+    size_t pos = 0;
+
+    // Tolerate leading whitespace from sloppy servers/bouncers
+    while (pos < end && line[pos] == ' ') pos++;
+
+    // Tags
+    if (pos < end && line[pos] == '@') {
+        size_t start = ++pos;
+        while (pos < end && line[pos] != ' ') pos++;
+        out.tags.offset = (uint16_t)start;
+        out.tags.length = (uint16_t)(pos - start);
+        while (pos < end && line[pos] == ' ') pos++;
+    }
+
+    // Prefix
+    if (pos < end && line[pos] == ':') {
+        size_t start = ++pos;
+        while (pos < end && line[pos] != ' ') pos++;
+        out.prefix.offset = (uint16_t)start;
+        out.prefix.length = (uint16_t)(pos - start);
+        while (pos < end && line[pos] == ' ') pos++;
+    }
+
+    // Command
+    size_t cmdStart = pos;
+    while (pos < end && line[pos] != ' ') pos++;
+    if (pos == cmdStart) return false;
+    out.command.offset = (uint16_t)cmdStart;
+    out.command.length = (uint16_t)(pos - cmdStart);
+    out.commandId = LookupIRCCommand(out.Command(), out.numeric);
+
+    // Params. Runs of spaces separate; a leading ':' (or hitting the
+    // 15th slot) makes the rest of the line one param, possibly empty.
+    while (out.paramCount < IRCMessageView::kMaxParams) {
+        while (pos < end && line[pos] == ' ') pos++;
+        if (pos >= end) break;
+
+        IRCSpan& param = out.params[out.paramCount++];
+        if (line[pos] == ':' || out.paramCount == IRCMessageView::kMaxParams) {
+            if (line[pos] == ':') pos++;
+            param.offset = (uint16_t)pos;
+            param.length = (uint16_t)(end - pos);
+            break;
+        }
+
+        size_t start = pos;
+        while (pos < end && line[pos] != ' ') pos++;
+        param.offset = (uint16_t)start;
+        param.length = (uint16_t)(pos - start);
+    }
+
+    return true;
+}
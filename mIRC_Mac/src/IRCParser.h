@@ -0,0 +1,61 @@
+#ifndef IRC_PARSER_H
+#define IRC_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "IRCCommand.h"
+
+// Offset/length pair pointing into the line a message was parsed from.
+// Lines are capped at 8191 + 512 bytes (tags + body), so 16 bits is enough.
+struct IRCSpan {
+    uint16_t offset;
+    uint16_t length;
+};
+
+// A parsed IRC line that owns no memory: every field is a span into the
+// caller's buffer, which must stay untouched while the view is in use.
+struct IRCMessageView {
+    static const int kMaxParams = 15;
+
+    const char* base;
+    IRCSpan tags;         // IRCv3 message tags, without the '@'
+    IRCSpan prefix;
+    IRCSpan command;
+    IRCCommand commandId; // classified during the parse
+    uint16_t numeric;     // reply number for numerics, else 0
+    IRCSpan params[kMaxParams];
+    int paramCount;
+
+    std::string_view Tags() const { return View(tags); }
+    std::string_view Prefix() const { return View(prefix); }
+    std::string_view Command() const { return View(command); }
+    std::string_view Param(int index) const {
+        return (index < paramCount) ? View(params[index]) : std::string_view();
+    }
+
+    // Nick part of a nick!user@host prefix (the whole prefix for servers)
+    std::string_view PrefixNick() const;
+
+    // Raw value of tag 'key' (empty for a bare key); false if absent.
+    // Escapes are left in place: server-time, batch and msgid never
+    // contain any.
+    bool Tag(std::string_view key, std::string_view& value) const;
+
+private:
+    std::string_view View(IRCSpan span) const { return std::string_view(base + span.offset, span.length); }
+};
+
+// Parsed server-time tag ("2024-03-01T12:34:56.789Z"), still in UTC
+struct IRCServerTime {
+    int year, month, day;
+    int hour, minute, second;
+};
+bool ParseIRCServerTime(std::string_view value, IRCServerTime& out);
+
+// Single pass, allocation free. 'line' excludes the CR/LF terminator.
+// Returns false for blank lines or lines without a command.
+bool ParseIRCLine(const char* line, size_t length, IRCMessageView& out);
+
+#endif // IRC_PARSER_H
@@ -0,0 +1,91 @@
+#include "InternTable.h"
+
+InternTable::InternTable(NamePool& storage)
+    : storage(storage), unreferenced(0), nameBytes(0), lookups(0), hits(0) {
+}
+
+InternTable::~InternTable() {
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].name.data()) storage.Release(entries[i].name);
+    }
+}
+
+void InternTable::SetMapping(CaseMapping mapping) {
+    // Names that only collide under the new mapping keep separate ids;
+    // lookups find whichever was interned first. Entries leave the index
+    // by identity, so pruning or respelling one leaves the other indexed.
+    // This does happen: a reconnect goes back to rfc1459 while windows
+    // keep ids interned under the previous server's mapping.
+    index.SetMapping(mapping);
+}
+
+InternId InternTable::Find(std::string_view name) const {
+    lookups++;
+    Entry* entry = index.Find(name);
+    if (!entry) return kNoIntern;
+    hits++;
+    return entry->id;
+}
+
+InternId InternTable::Acquire(std::string_view name) {
+    lookups++;
+    Entry* entry = index.Find(name);
+    if (entry) {
+        hits++;
+        Retain(entry->id);
+        return entry->id;
+    }
+
+    InternId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = (InternId)entries.size();
+        entries.push_back(Entry());
+    }
+    entry = &entries[id];
+    entry->name = storage.Acquire(name);
+    entry->id = id;
+    entry->refs = 1;
+    nameBytes += NamePool::Footprint(name.size());
+    index.Insert(entry->name, entry);
+    return id;
+}
+
+void InternTable::Release(InternId id) {
+    if (--entries[id].refs == 0) unreferenced++;
+}
+
+void InternTable::Respell(InternId id, std::string_view name) {
+    Entry& entry = entries[id];
+    if (entry.name == name) return;
+
+    index.Remove(entry.name, &entry);
+    nameBytes -= NamePool::Footprint(entry.name.size());
+    storage.Release(entry.name);
+    entry.name = storage.Acquire(name);
+    nameBytes += NamePool::Footprint(name.size());
+    index.Insert(entry.name, &entry);
+}
+
+size_t InternTable::Prune() {
+    size_t freed = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        Entry& entry = entries[i];
+        if (!entry.name.data() || entry.refs) continue;
+        index.Remove(entry.name, &entry);
+        nameBytes -= NamePool::Footprint(entry.name.size());
+        storage.Release(entry.name);
+        entry.name = std::string_view();
+        freeIds.push_back(entry.id);
+        freed++;
+    }
+    unreferenced = 0;
+    return freed;
+}
+
+size_t InternTable::MemoryBytes() const {
+    return entries.size() * sizeof(Entry) + freeIds.capacity() * sizeof(InternId) +
+           index.MemoryBytes() + nameBytes;
+}
@@ -0,0 +1,83 @@
+#ifndef INTERN_TABLE_H
+#define INTERN_TABLE_H
+
+#include "Arena.h"
+#include "CaseMap.h"
+#include "TargetIndex.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <vector>
+
+// Small integer standing for one case-folded identifier (nick or channel)
+typedef uint32_t InternId;
+static const InternId kNoIntern = 0xFFFFFFFFu;
+
+// Session-wide table of the nicks and channel names we know about. Each
+// identifier is hashed and stored once and handed out as an InternId, so
+// membership, window routing and anything else keyed by a name compare
+// integers instead of strings. Two spellings that fold to the same name
+// under the current CASEMAPPING share an id.
+//
+// Entries are reference counted. One that drops to zero stays in the
+// table, so a nick that comes straight back (rejoin, reconnect) is still
+// a hit; Prune() frees them once there are more than kPruneSlack.
+class InternTable {
+public:
+    static const size_t kPruneSlack = 256;
+
+    explicit InternTable(NamePool& storage);
+    ~InternTable();
+
+    void SetMapping(CaseMapping mapping);
+    CaseMapping Mapping() const { return index.Mapping(); }
+
+    // kNoIntern if the name is not in the table
+    InternId Find(std::string_view name) const;
+    // Finds or adds the name and takes a reference to it
+    InternId Acquire(std::string_view name);
+    void Retain(InternId id) {
+        if (entries[id].refs++ == 0) unreferenced--;
+    }
+    void Release(InternId id);
+    // Same identifier, new spelling (a NICK that only changes case)
+    void Respell(InternId id, std::string_view name);
+
+    // Valid until the entry is pruned or respelled
+    std::string_view Name(InternId id) const { return entries[id].name; }
+    // One past the highest id handed out, for sizing per-id arrays
+    size_t Capacity() const { return entries.size(); }
+
+    bool WantsPrune() const { return unreferenced > kPruneSlack; }
+    // Frees every entry nobody references; returns how many went
+    size_t Prune();
+
+    size_t Size() const { return index.Size(); }
+    size_t Unreferenced() const { return unreferenced; }
+    unsigned long Lookups() const { return lookups; }
+    unsigned long Hits() const { return hits; }
+    // Entry records, hash slots and name storage
+    size_t MemoryBytes() const;
+
+private:
+    struct Entry {
+        std::string_view name;  // NamePool storage, null when free; key of index
+        InternId id;
+        uint32_t refs;
+    };
+
+    NamePool& storage;
+    std::deque<Entry> entries;    // indexed by id; deque keeps addresses stable
+    std::vector<InternId> freeIds;
+    TargetIndex<Entry> index;
+    size_t unreferenced;
+    size_t nameBytes;
+    mutable unsigned long lookups;
+    mutable unsigned long hits;
+
+    InternTable(const InternTable&);
+    InternTable& operator=(const InternTable&);
+};
+
+#endif // INTERN_TABLE_H
@@ -0,0 +1,95 @@
+#include "LineBuffer.h"
+#include <cstring>
+
+static const uint32_t kMask = LineBuffer::kCapacity - 1;
+
+LineBuffer::LineBuffer()
+    : data(new char[kCapacity]), scratch(new char[kMaxTaggedLineLength]),
+      head(0), tail(0), scan(0), discarding(false), overlongLines(0) {
+}
+
+LineBuffer::~LineBuffer() {
+    delete[] data;
+    delete[] scratch;
+}
+
+void LineBuffer::Clear() {
+    head = tail = scan = 0;
+    discarding = false;
+}
+
+char* LineBuffer::WritePtr(size_t& avail) {
+    uint32_t free = kCapacity - (tail - head);
+    uint32_t offset = tail & kMask;
+    uint32_t toEnd = kCapacity - offset;
+    avail = (free < toEnd) ? free : toEnd;
+    return data + offset;
+}
+
+void LineBuffer::Commit(size_t bytes) {
+    tail += (uint32_t)bytes;
+}
+
+// Searches [scan, tail) for '\n' one contiguous segment at a time
+bool LineBuffer::FindNewline(uint32_t& found) {
+    while (scan != tail) {
+        uint32_t offset = scan & kMask;
+        uint32_t run = tail - scan;
+        if (run > kCapacity - offset) run = kCapacity - offset;
+
+        const char* nl = (const char*)memchr(data + offset, '\n', run);
+        if (nl) {
+            found = scan + (uint32_t)(nl - (data + offset));
+            scan = found + 1;
+            return true;
+        }
+        scan += run;
+    }
+    return false;
+}
+
+bool LineBuffer::NextLine(const char*& line, size_t& length) {
+    uint32_t nl;
+    while (FindNewline(nl)) {
+        uint32_t start = head;
+        head = nl + 1;
+
+        if (discarding) {
+            // Tail end of a line we already gave up on
+            discarding = false;
+            continue;
+        }
+
+        uint32_t len = nl - start;
+        if (len > 0 && data[(nl - 1) & kMask] == '\r') len--;
+        if (len == 0) continue;
+
+        size_t limit = (data[start & kMask] == '@') ? kMaxTaggedLineLength : kMaxLineLength;
+        if (len + 2 > limit) {
+            overlongLines++;
+            continue;
+        }
+
+        uint32_t offset = start & kMask;
+        if (offset + len <= kCapacity) {
+            line = data + offset;
+        } else {
+            // Straddles the end of the ring: stitch the two halves together
+            uint32_t first = kCapacity - offset;
+            memcpy(scratch, data + offset, first);
+            memcpy(scratch + first, data, len - first);
+            line = scratch;
+        }
+        length = len;
+        return true;
+    }
+
+    // No terminator yet. If the partial line can no longer fit, drop what we
+    // have and skip up to the next newline so the ring never clogs.
+    if (Used() >= kMaxTaggedLineLength) {
+        if (!discarding) overlongLines++;
+        discarding = true;
+        head = tail;
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#ifndef LINE_BUFFER_H
+#define LINE_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity circular receive buffer with in-place line framing.
+//
+// The socket reads straight into WritePtr(); NextLine() hands out complete
+// lines as pointers into the ring and releases them by advancing the read
+// index. Only a line that straddles the physical end of the ring is copied
+// (into a small scratch buffer) so the parser always sees contiguous bytes.
+// Memory use is fixed at construction no matter how fast data arrives.
+class LineBuffer {
+public:
+    static const size_t kCapacity = 16384;          // must be a power of two
+    static const size_t kMaxLineLength = 512;       // RFC 1459, CRLF included
+    static const size_t kMaxTaggedLineLength = 8191 + 512; // IRCv3 tags + body
+
+    LineBuffer();
+    ~LineBuffer();
+
+    // Contiguous free space for the next read. 'avail' may be less than the
+    // total free space when the free region wraps.
+    char* WritePtr(size_t& avail);
+    void Commit(size_t bytes);
+
+    // Next complete line without its CR/LF. Accepts "\r\n" and bare "\n".
+    // The pointer stays valid until the next WritePtr/Commit/NextLine call.
+    bool NextLine(const char*& line, size_t& length);
+
+    size_t Used() const { return (size_t)(tail - head); }
+    void Clear();
+
+    // Lines thrown away for exceeding the length limit
+    unsigned long OverlongLines() const { return overlongLines; }
+
+private:
+    char* data;
+    char* scratch;
+    uint32_t head;  // read index (free running, masked on access)
+    uint32_t tail;  // write index
+    uint32_t scan;  // first byte not yet searched for '\n'
+    bool discarding; // dropping the rest of an overlong line
+    unsigned long overlongLines;
+
+    LineBuffer(const LineBuffer&);
+    LineBuffer& operator=(const LineBuffer&);
+
+    bool FindNewline(uint32_t& found);
+};
+
+#endif // LINE_BUFFER_H
@@ -0,0 +1,295 @@
+#include "LogWriter.h"
+#include "FileIO.h"
+#include "PhaseStats.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(LOCAL_TESTING) || defined(__unix__)
+static const char* const kDefaultDirectory = "logs";
+#else
+// Partial path: a folder next to the application
+static const char* const kDefaultDirectory = ":Logs";
+#endif
+
+// HFS names are at most 31 characters; this leaves room for ".yyyymmdd.log"
+static const size_t kMaxNameLength = 18;
+
+static void PutBigEndian(std::string& out, uint32_t value) {
+    char bytes[4] = { (char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value };
+    out.append(bytes, 4);
+}
+
+static uint32_t GetBigEndian(const char* in) {
+    const unsigned char* p = (const unsigned char*)in;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+LogWriter::LogWriter()
+    : directory(kDefaultDirectory), directoryReady(false), clockOverridden(false), dateKey(0),
+      secondOfDay(0), nextPoll(0) {
+    memset(&stats, 0, sizeof(stats));
+    memset(&overrideDate, 0, sizeof(overrideDate));
+    memset(dateText, 0, sizeof(dateText));
+    memcpy(stamp, "[00:00] ", sizeof(stamp));
+    UpdateClock();
+}
+
+LogWriter::~LogWriter() {
+    FlushAll();
+}
+
+void LogWriter::SetDirectory(std::string_view path) {
+    directory.assign(path.data(), path.size());
+    directoryReady = false;
+}
+
+void LogWriter::SetClockOverride(const ClockDate* date) {
+    clockOverridden = (date != nullptr);
+    if (date) overrideDate = *date;
+    UpdateClock();
+}
+
+int LogWriter::Open(std::string_view target) {
+    if (!Enabled()) return -1;
+
+    size_t slot = 0;
+    while (slot < files.size() && files[slot].inUse) slot++;
+    if (slot == files.size()) files.push_back(File());
+
+    File& file = files[slot];
+    file.inUse = true;
+    file.lines = 0;
+    file.firstMillis = 0;
+    file.segmentKnown = false;
+    file.segmentLines = 0;
+    file.segmentBytes = 0;
+    file.buffer.reserve(kFlushBytes * 2);
+    file.index.clear();
+
+    // Keep it a plain file name everywhere: no separators, no dot files
+    file.name.clear();
+    for (size_t i = 0; i < target.size() && file.name.size() < kMaxNameLength; i++) {
+        char c = target[i];
+        bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                    strchr("#&+-_", c) != nullptr;
+        file.name += (safe && c != '\0') ? c : '_';
+    }
+    if (file.name.empty()) file.name = "_";
+    return (int)slot;
+}
+
+void LogWriter::Close(int handle) {
+    if (handle < 0 || (size_t)handle >= files.size() || !files[handle].inUse) return;
+    File& file = files[handle];
+    Flush(file, false);
+    file.inUse = false;
+    std::string().swap(file.buffer);
+    std::vector<PendingIndex>().swap(file.index);
+}
+
+void LogWriter::Flush(int handle) {
+    if (handle < 0 || (size_t)handle >= files.size() || !files[handle].inUse) return;
+    Flush(files[handle], false);
+}
+
+std::string_view LogWriter::FileName(int handle) const {
+    if (handle < 0 || (size_t)handle >= files.size() || !files[handle].inUse) return std::string_view();
+    return files[handle].name;
+}
+
+void LogWriter::Append(int handle, std::initializer_list<std::string_view> pieces) {
+    if (handle < 0 || (size_t)handle >= files.size() || !files[handle].inUse) return;
+    File& file = files[handle];
+
+    size_t before = file.buffer.size();
+    if (before == 0) file.firstMillis = ClockMillis();
+    if (file.lines % kIndexInterval == 0) {
+        PendingIndex entry = { file.lines, (uint32_t)before, secondOfDay };
+        file.index.push_back(entry);
+    }
+    file.buffer.append(stamp, sizeof(stamp) - 1);
+    for (std::string_view piece : pieces) file.buffer.append(piece.data(), piece.size());
+    file.buffer += kLineEnd;
+    file.lines++;
+
+    stats.linesLogged++;
+    stats.windowLines++;
+    stats.bytesLogged += file.buffer.size() - before;
+
+    // Only a flood with no idle pass for a long while gets here
+    if (file.buffer.size() >= kHardLimitBytes) {
+        stats.forcedFlushes++;
+        Flush(file, false);
+    }
+}
+
+// Refreshes the cached stamp, and rotates everyone's files at midnight
+void LogWriter::UpdateClock() {
+    ClockDate date;
+    if (clockOverridden) date = overrideDate;
+    else ClockLocalDate(date);
+
+    int key = date.year * 10000 + date.month * 100 + date.day;
+    if (key != dateKey) {
+        // Lines already buffered belong to the day they arrived on
+        if (dateKey != 0) {
+            for (size_t i = 0; i < files.size(); i++) {
+                if (!files[i].inUse) continue;
+                Flush(files[i], false);
+                files[i].segmentKnown = false;
+            }
+            stats.rotations++;
+        }
+        dateKey = key;
+        snprintf(dateText, sizeof(dateText), "%08d", key);
+    }
+
+    char text[16];
+    snprintf(text, sizeof(text), "[%02d:%02d] ", date.hour % 100, date.minute % 100);
+    memcpy(stamp, text, sizeof(stamp));
+    secondOfDay = (uint32_t)(date.hour * 3600 + date.minute * 60 + date.second);
+}
+
+void LogWriter::Poll(bool idle) {
+    UpdateClock();
+
+    uint32_t now = ClockMillis();
+    if ((uint32_t)(now - stats.windowStart) >= 1000) {
+        stats.linesPerSecond = stats.windowLines;
+        stats.windowLines = 0;
+        stats.windowStart = now;
+    }
+
+    uint32_t start = ClockMicros();
+    bool wrote = false;
+    size_t count = files.size();
+    for (size_t n = 0; n < count; n++) {
+        size_t i = (nextPoll + n) % count;
+        File& file = files[i];
+        if (!file.inUse || file.buffer.empty()) continue;
+
+        // Busy: one block per pass, and only once it is worth writing
+        if (!idle) {
+            bool full = file.buffer.size() >= kFlushBytes;
+            bool stale = (uint32_t)(now - file.firstMillis) >= kFlushMillis;
+            if (!full && !stale) continue;
+        }
+        Flush(file, false);
+        wrote = true;
+        if (!idle) {
+            nextPoll = i + 1;
+            break;
+        }
+    }
+
+    if (wrote) {
+        uint32_t micros = ClockMicros() - start;
+        PhaseRecord(kPhaseLogFlush, micros);
+        if (micros > stats.maxStallMicros) stats.maxStallMicros = micros;
+    }
+}
+
+void LogWriter::FlushAll() {
+    uint32_t start = ClockMicros();
+    bool wrote = false;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i].inUse && !files[i].buffer.empty()) {
+            Flush(files[i], true);
+            wrote = true;
+        }
+    }
+
+    if (wrote) {
+        uint32_t micros = ClockMicros() - start;
+        PhaseRecord(kPhaseLogFlush, micros);
+        if (micros > stats.maxStallMicros) stats.maxStallMicros = micros;
+    }
+}
+
+void LogWriter::SegmentPath(const File& file, const char* extension, std::string& path) const {
+    path.assign(directory);
+    path += kPathSeparator;
+    path += file.name;
+    path += '.';
+    path += dateText;
+    path += extension;
+}
+
+void LogWriter::LoadSegment(File& file, const std::string& logPath, const std::string& indexPath) {
+    file.segmentLines = 0;
+    file.segmentBytes = 0;
+    file.segmentKnown = true;
+
+    long size = FileSize(logPath);
+    if (size <= 0) return;
+    file.segmentBytes = (uint32_t)size;
+
+    // The last index record is at most one block from the end; count
+    // the lines after it
+    uint32_t line = 0, offset = 0;
+    long indexSize = FileSize(indexPath);
+    int handle = (indexSize >= (long)kIndexRecordSize) ? FileOpenRead(indexPath) : -1;
+    if (handle >= 0) {
+        char record[kIndexRecordSize];
+        uint32_t last = (uint32_t)(indexSize / kIndexRecordSize - 1) * kIndexRecordSize;
+        if (FileReadAt(handle, last, record, sizeof(record)) == (long)sizeof(record)) {
+            line = GetBigEndian(record);
+            offset = GetBigEndian(record + 4);
+        }
+        FileClose(handle);
+    }
+    if (offset > file.segmentBytes) line = offset = 0;
+
+    handle = FileOpenRead(logPath);
+    if (handle < 0) return;
+    char chunk[1024];
+    while (offset < file.segmentBytes) {
+        long got = FileReadAt(handle, offset, chunk, sizeof(chunk));
+        if (got <= 0) break;
+        for (long i = 0; i < got; i++) {
+            if (chunk[i] == kLineEnd) line++;
+        }
+        offset += (uint32_t)got;
+    }
+    FileClose(handle);
+    file.segmentLines = line;
+}
+
+bool LogWriter::Flush(File& file, bool sync) {
+    if (file.buffer.empty()) return true;
+
+    std::string& path = pathScratch;
+    SegmentPath(file, ".log", path);
+    if (!directoryReady) directoryReady = FileMakeDirectory(directory);
+
+    std::string indexPath;
+    SegmentPath(file, ".idx", indexPath);
+    if (directoryReady && !file.segmentKnown) LoadSegment(file, path, indexPath);
+
+    bool ok = directoryReady && FileAppend(path, file.buffer.data(), file.buffer.size(), sync);
+    if (ok) {
+        stats.blocksWritten++;
+        stats.bytesWritten += file.buffer.size();
+
+        std::string& records = indexScratch;
+        records.clear();
+        for (size_t i = 0; i < file.index.size(); i++) {
+            const PendingIndex& entry = file.index[i];
+            PutBigEndian(records, file.segmentLines + entry.line);
+            PutBigEndian(records, file.segmentBytes + entry.offset);
+            PutBigEndian(records, entry.second);
+        }
+        // A missing record only makes seeks scan a little further
+        if (!records.empty()) FileAppend(indexPath, records.data(), records.size(), sync);
+        file.segmentLines += file.lines;
+        file.segmentBytes += (uint32_t)file.buffer.size();
+    } else {
+        // Nowhere to put it; holding on would only grow the heap
+        stats.writeErrors += file.lines;
+        file.segmentKnown = false;
+    }
+    file.buffer.clear();
+    file.index.clear();
+    file.lines = 0;
+    return ok;
+}
@@ -0,0 +1,123 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include "Clock.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Per-target log files, one per day: <dir>/<target>.<yyyymmdd>.log.
+// Append() only copies the line into the file's buffer; the disk is
+// touched from Poll(), which the event loop calls after each pass. An
+// idle pass writes out everything, a busy one only buffers that are over
+// kFlushBytes or older than kFlushMillis, one file per pass. Each write
+// opens the file for append and closes it again, so the Mac never holds
+// more than one FCB and nothing is left half open after a crash.
+//
+// Each day file is also a history segment (see History.h): next to it,
+// <target>.<yyyymmdd>.idx holds a sparse index of big-endian records
+// { line, byte offset, second of day }, one for the first line of every
+// written block and every kIndexInterval lines after that. Data is
+// written before its index records, so the index never points past the
+// end of the log.
+class LogWriter {
+public:
+    static const unsigned kIndexInterval = 64;
+    static const size_t kIndexRecordSize = 12;
+
+    // Block size worth a disk write, and how long a line may wait
+    static const size_t kFlushBytes = 4096;
+    static const uint32_t kFlushMillis = 5000;
+    // A buffer this full is written from Append() rather than grown
+    static const size_t kHardLimitBytes = 32 * 1024;
+
+    struct Stats {
+        unsigned long linesLogged;
+        unsigned long bytesLogged;
+        unsigned long blocksWritten;
+        unsigned long bytesWritten;
+        unsigned long forcedFlushes;  // Append() hit kHardLimitBytes
+        unsigned long writeErrors;    // lines lost to failed writes
+        unsigned long rotations;
+        uint32_t maxStallMicros;      // longest Poll()/FlushAll() spent writing
+        unsigned linesPerSecond;      // over the last full second
+        uint32_t windowStart;
+        unsigned windowLines;
+    };
+
+    LogWriter();
+    ~LogWriter();
+
+    // Where files go, created on the first write; empty turns logging off
+    void SetDirectory(std::string_view path);
+    bool Enabled() const { return !directory.empty(); }
+    const std::string& Directory() const { return directory; }
+    // Stamps and rotation follow this date instead of the clock (tools
+    // that generate logs); null goes back to the clock
+    void SetClockOverride(const ClockDate* date);
+
+    // Returns a handle for Append(), -1 when logging is off
+    int Open(std::string_view target);
+    // Writes out whatever the handle still holds
+    void Close(int handle);
+    void Append(int handle, std::initializer_list<std::string_view> pieces);
+    // Writes the handle's buffer now, e.g. before its history is read
+    void Flush(int handle);
+    // File-safe form of the handle's target, as used in file names
+    std::string_view FileName(int handle) const;
+
+    void Poll(bool idle);
+    // Disconnect and quit: write every buffer now and sync the volume
+    void FlushAll();
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    // Index record for a buffered line, relative to the buffer until the
+    // block is written and the segment's size is known
+    struct PendingIndex {
+        uint32_t line;
+        uint32_t offset;
+        uint32_t second;
+    };
+
+    struct File {
+        bool inUse;
+        std::string name;    // target, made safe for a file name
+        std::string buffer;  // stamped lines not yet on disk
+        unsigned lines;
+        uint32_t firstMillis;  // when the oldest buffered line arrived
+        std::vector<PendingIndex> index;
+        bool segmentKnown;     // segmentLines/Bytes match today's file
+        uint32_t segmentLines;
+        uint32_t segmentBytes;
+    };
+
+    std::vector<File> files;
+    std::string directory;
+    bool directoryReady;
+    bool clockOverridden;
+    ClockDate overrideDate;
+    int dateKey;           // yyyymmdd the open files belong to
+    char dateText[9];      // "yyyymmdd"
+    char stamp[9];         // "[hh:mm] "
+    uint32_t secondOfDay;  // as of the last clock update
+    std::string pathScratch;
+    std::string indexScratch;
+    size_t nextPoll;       // round-robin start for busy passes
+    Stats stats;
+
+    void UpdateClock();
+    bool Flush(File& file, bool sync);
+    // Picks up where an existing day file left off (restart, rotation)
+    void LoadSegment(File& file, const std::string& logPath, const std::string& indexPath);
+    void SegmentPath(const File& file, const char* extension, std::string& path) const;
+
+    LogWriter(const LogWriter&);
+    LogWriter& operator=(const LogWriter&);
+};
+
+#endif // LOG_WRITER_H
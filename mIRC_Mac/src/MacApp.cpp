@@ -1,4 +1,8 @@
 #include "MacApp.h"
+#include "Clock.h"
+#include "HeapStats.h"
+#include "PhaseStats.h"
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 
@@ -19,7 +23,48 @@ const int kCmdJoin = 1;
 const int kCmdPart = 2;
 const int kCmdList = 4;
 
-MacApp::MacApp() : running(false) {
+// WaitNextEvent sleep bounds, in ticks. Network data does not wake us on
+// the Mac, so while connected the cap is also the worst-case added latency.
+const uint32_t kMaxSleepConnected = 6;
+const uint32_t kMaxSleepOffline = 60;
+
+// Scrollback caps. logTE only ever shows the tail of a window's history;
+// once it grows past kLogViewMaxBytes it is rebuilt with the last
+// kLogViewKeepBytes, keeping TextEdit well clear of its 32K limit.
+const size_t kScrollbackWindowCap = 64 * 1024;
+const size_t kScrollbackGlobalCap = 256 * 1024;
+const size_t kLogViewMaxBytes = 16 * 1024;
+const size_t kLogViewKeepBytes = 8 * 1024;
+
+// Extended keyboard character codes that page through history
+const char kHomeKey = 0x01;
+const char kEndKey = 0x04;
+const char kPageUpKey = 0x0B;
+const char kPageDownKey = 0x0C;
+
+// Time /search may take per event-loop pass, about one tick
+const uint32_t kSearchSliceMicros = 16000;
+
+// Longest a server batch may hold back redraws, in case its end is lost
+const uint32_t kBatchHoldMillis = 3000;
+
+// Styled logTE: ^Q monospace switches to Monaco; TextEdit takes at most
+// this many style changes in one insert
+const int16_t kMonacoFontID = 4;
+const size_t kMaxScrapStyles = 1601;
+
+// mIRC's 16 colours; 16-98 are shown in the default
+static const RGBColor kIRCColors[16] = {
+    { 0xFFFF, 0xFFFF, 0xFFFF }, { 0x0000, 0x0000, 0x0000 }, { 0x0000, 0x0000, 0x7F7F }, { 0x0000, 0x9393, 0x0000 },
+    { 0xFFFF, 0x0000, 0x0000 }, { 0x7F7F, 0x0000, 0x0000 }, { 0x9C9C, 0x0000, 0x9C9C }, { 0xFCFC, 0x7F7F, 0x0000 },
+    { 0xFFFF, 0xFFFF, 0x0000 }, { 0x0000, 0xFCFC, 0x0000 }, { 0x0000, 0x9393, 0x9393 }, { 0x0000, 0xFFFF, 0xFFFF },
+    { 0x0000, 0x0000, 0xFCFC }, { 0xFFFF, 0x0000, 0xFFFF }, { 0x7F7F, 0x7F7F, 0x7F7F }, { 0xD2D2, 0xD2D2, 0xD2D2 },
+};
+
+MacApp::MacApp()
+    : running(false), scrollbackPool(kScrollbackGlobalCap), styleScrap(nil), resultsWindow(nil), statusWindow(nil) {
+    memset(&loopStats, 0, sizeof(loopStats));
+    memset(&redrawStats, 0, sizeof(redrawStats));
 }
 
 MacApp::~MacApp() {
@@ -28,12 +73,7 @@ MacApp::~MacApp() {
 void MacApp::Init() {
     InitializeToolbox();
     SetupMenus();
-
-    // Bind IRC callbacks
-    irc.onLog = [this](const std::string& msg) { this->OnIRCLog(msg); };
-    irc.onMessage = [this](const std::string& t, const std::string& s, const std::string& m) { this->OnIRCMessage(t, s, m); };
-    irc.onJoin = [this](const std::string& c) { this->OnIRCJoin(c); };
-    irc.onPart = [this](const std::string& c) { this->OnIRCPart(c); };
+    styleScrap = (StScrpHandle)NewHandle(offsetof(StScrpRec, scrpStyleTab));
 
     CreateStatusWindow();
 }
@@ -69,16 +109,81 @@ void MacApp::SetupMenus() {
 void MacApp::Run() {
     running = true;
     EventRecord event;
+    bool userActive = false;
+
+    IRCClient::State lastState = irc.GetState();
 
     while (running) {
         // Run IRC Update
-        irc.Update();
+        unsigned long busyTicks = irc.GetReadStats().ticks;
+        irc.Update(*this);
+        bool networkActive = irc.GetReadStats().ticks != busyTicks;
+
+        // A running /search gets a slice of every pass
+        bool searching = search.Running();
+        if (searching) StepSearch();
+
+        // One batched insert per window per pass, however many lines came in
+        FlushRedraws();
+
+        // Disk writes wait for a quiet pass unless a buffer is due; losing
+        // the connection writes everything out at once
+        IRCClient::State state = irc.GetState();
+        if (state == IRCClient::State::Disconnected && lastState != IRCClient::State::Disconnected) {
+            logWriter.FlushAll();
+            ClearBatchHolds();
+        } else {
+            logWriter.Poll(!networkActive && !userActive);
+        }
+        lastState = state;
+
+        uint32_t sleep = NextSleepTicks(networkActive || userActive || searching);
+#ifdef LOCAL_TESTING
+        // The mock WaitNextEvent never sleeps; block on the socket instead
+        irc.WaitForActivity(sleep * 1000 / 60);
+#endif
 
         // Handle Mac Events
-        if (WaitNextEvent(everyEvent, &event, 0, nil)) {
+        userActive = false;
+        if (WaitNextEvent(everyEvent, &event, sleep, nil)) {
             HandleEvent(event);
+            userActive = (event.what != nullEvent);
         }
     }
+
+    logWriter.FlushAll();
+}
+
+// Sleep nothing while there is work, then back off exponentially so a
+// silent channel costs a handful of wake-ups per second.
+uint32_t MacApp::NextSleepTicks(bool active) {
+    uint32_t now = ClockMillis();
+    loopStats.wakeups++;
+    loopStats.windowWakeups++;
+    if (active) loopStats.busyWakeups++;
+    if ((uint32_t)(now - loopStats.windowStart) >= 1000) {
+        loopStats.wakeupsPerSecond = loopStats.windowWakeups;
+        loopStats.windowWakeups = 0;
+        loopStats.windowStart = now;
+    }
+
+    uint32_t cap = (irc.GetState() == IRCClient::State::Disconnected) ? kMaxSleepOffline : kMaxSleepConnected;
+    uint32_t sleep = loopStats.sleepTicks;
+    if (active || irc.HasPendingInput()) {
+        sleep = 0;
+    } else {
+        sleep = sleep ? sleep * 2 : 1;
+        if (sleep > cap) sleep = cap;
+    }
+
+    // Wake up in time for the flood control to release the next line
+    if (!irc.GetOutboundQueue().Empty()) {
+        uint32_t ready = (irc.GetOutboundQueue().MillisUntilReady(now) * 60 + 999) / 1000;
+        if (ready < sleep) sleep = ready;
+    }
+
+    loopStats.sleepTicks = sleep;
+    return sleep;
 }
 
 void MacApp::HandleEvent(EventRecord& event) {
@@ -211,7 +316,7 @@ void MacApp::DoMenuCommand(long menuResult) {
                  break;
              case kCmdPart:
                  if (data && data->type == kWindowTypeChannel) {
-                     irc.Part(data->target);
+                     irc.Part(irc.GetInterns().Name(data->target));
                      // Close window?
                  }
                  break;
@@ -232,6 +337,8 @@ void MacApp::DoKeyDown(EventRecord& event) {
             if (data) {
                 if (key == '\r' || key == '\n' || key == 3) { // Enter
                     HandleInput(window);
+                } else if (key == kHomeKey || key == kEndKey || key == kPageUpKey || key == kPageDownKey) {
+                    PageHistory(window, data, key);
                 } else {
                     TEKey(key, data->inputTE);
                 }
@@ -247,6 +354,8 @@ void MacApp::DoUpdate(EventRecord& event) {
 
     ChatWindowData* data = (ChatWindowData*)GetWRefCon(window);
     if (data) {
+        PhaseScope timer(kPhaseRedraw);
+        CountRedraw(0, true);
         EraseRect(&window->portRect);
         TEUpdate(&data->logTE[0]->viewRect, data->logTE);
 
@@ -267,6 +376,8 @@ void MacApp::DoActivate(EventRecord& event) {
     ChatWindowData* data = (ChatWindowData*)GetWRefCon(window);
     if (data) {
         if (active) {
+            // Catch up on whatever arrived while we were in the background
+            FlushLogView(window, data);
             TEActivate(data->inputTE);
             TEActivate(data->logTE);
         } else {
@@ -278,11 +389,19 @@ void MacApp::DoActivate(EventRecord& event) {
 
 // Window Management
 WindowPtr MacApp::CreateStatusWindow() {
+    HEAP_SCOPE(kHeapWindowCreate);
     WindowPtr window = GetNewWindow(kStatusWindowID, nil, (WindowPtr)-1);
 
     ChatWindowData* data = new ChatWindowData();
+    data->window = window;
     data->type = kWindowTypeStatus;
-    data->target = "";
+    data->scrollback = new Scrollback(scrollbackPool, kScrollbackWindowCap);
+    data->viewFirstLine = 0;
+    data->viewEndLine = 0;
+    data->dirty = false;
+    data->target = kNoIntern;
+    data->logFile = logWriter.Open("status");
+    data->history = nullptr;
 
     SetPort(window);
     TextFont(0); // System Font
@@ -298,20 +417,22 @@ WindowPtr MacApp::CreateStatusWindow() {
     inputRect.right -= 2;
     inputRect.bottom -= 2;
 
-    data->logTE = TENew(&logRect, &logRect);
+    data->logTE = TEStyleNew(&logRect, &logRect);
     data->inputTE = TENew(&inputRect, &inputRect);
 
     SetWRefCon(window, (long)data);
+    statusWindow = window;
 
     ShowWindow(window);
     return window;
 }
 
-WindowPtr MacApp::CreateChannelWindow(const std::string& name) {
+WindowPtr MacApp::CreateChannelWindow(std::string_view name) {
+    HEAP_SCOPE(kHeapWindowCreate);
     WindowPtr window = GetNewWindow(kChannelWindowID, nil, (WindowPtr)-1);
 
     Str255 pName;
-    const char* cStr = name.c_str();
+    const char* cStr = name.data();
     int len = name.length();
     if (len > 255) len = 255;
     pName[0] = len;
@@ -319,8 +440,15 @@ WindowPtr MacApp::CreateChannelWindow(const std::string& name) {
     SetWTitle(window, pName);
 
     ChatWindowData* data = new ChatWindowData();
+    data->window = window;
     data->type = kWindowTypeChannel;
-    data->target = name;
+    data->scrollback = new Scrollback(scrollbackPool, kScrollbackWindowCap);
+    data->viewFirstLine = 0;
+    data->viewEndLine = 0;
+    data->dirty = false;
+    data->target = irc.GetInterns().Acquire(name);
+    data->logFile = logWriter.Open(name);
+    data->history = nullptr;
 
     SetPort(window);
     TextFont(0);
@@ -336,7 +464,50 @@ WindowPtr MacApp::CreateChannelWindow(const std::string& name) {
     inputRect.right -= 2;
     inputRect.bottom -= 2;
 
-    data->logTE = TENew(&logRect, &logRect);
+    data->logTE = TEStyleNew(&logRect, &logRect);
+    data->inputTE = TENew(&inputRect, &inputRect);
+
+    SetWRefCon(window, (long)data);
+    if (data->target >= windowsByTarget.size()) windowsByTarget.resize(data->target + 1, nullptr);
+    windowsByTarget[data->target] = data;
+    ShowWindow(window);
+    return window;
+}
+
+WindowPtr MacApp::CreateResultsWindow() {
+    HEAP_SCOPE(kHeapWindowCreate);
+    WindowPtr window = GetNewWindow(kChannelWindowID, nil, (WindowPtr)-1);
+    Str255 title;
+    title[0] = 6;
+    memcpy(title + 1, "Search", 6);
+    SetWTitle(window, title);
+
+    ChatWindowData* data = new ChatWindowData();
+    data->window = window;
+    data->type = kWindowTypeResults;
+    data->scrollback = new Scrollback(scrollbackPool, kScrollbackWindowCap);
+    data->viewFirstLine = 0;
+    data->viewEndLine = 0;
+    data->dirty = false;
+    data->target = kNoIntern;
+    data->logFile = -1;
+    data->history = nullptr;
+
+    SetPort(window);
+    TextFont(0);
+    TextSize(12);
+
+    Rect logRect = window->portRect;
+    logRect.bottom -= 20;
+    logRect.right -= 15;
+
+    Rect inputRect = window->portRect;
+    inputRect.top = inputRect.bottom - 18;
+    inputRect.left += 2;
+    inputRect.right -= 2;
+    inputRect.bottom -= 2;
+
+    data->logTE = TEStyleNew(&logRect, &logRect);
     data->inputTE = TENew(&inputRect, &inputRect);
 
     SetWRefCon(window, (long)data);
@@ -377,24 +548,507 @@ void MacApp::DisposeChatWindow(WindowPtr window) {
     if (data) {
         TEDispose(data->logTE);
         TEDispose(data->inputTE);
+        logWriter.Close(data->logFile);
+        delete data->history;
+        search.RemoveSource(data->scrollback);
+        if (window == resultsWindow) {
+            resultsWindow = nil;
+            search.Cancel();
+        }
+        if (data->dirty) {
+            for (size_t i = 0; i < dirtyWindows.size(); i++) {
+                if (dirtyWindows[i] == window) {
+                    dirtyWindows.erase(dirtyWindows.begin() + i);
+                    break;
+                }
+            }
+        }
+        if (data->type == kWindowTypeStatus) {
+            statusWindow = nil;
+        } else if (data->type == kWindowTypeChannel) {
+            windowsByTarget[data->target] = nullptr;
+            irc.GetInterns().Release(data->target);
+        }
+        delete data->scrollback;
         delete data;
     }
     DisposeWindow(window);
 }
 
-void MacApp::AppendText(WindowPtr window, const std::string& text) {
+void MacApp::AppendText(WindowPtr window, std::string_view text) {
+    AppendText(window, { text });
+}
+
+void MacApp::AppendText(WindowPtr window, std::initializer_list<std::string_view> pieces) {
+    HEAP_SCOPE(kHeapAppendText);
+    PhaseScope timer(kPhaseAppend, PhaseSample(kPhaseAppend));
     ChatWindowData* data = (ChatWindowData*)GetWRefCon(window);
     if (!data) return;
 
-    std::string line = text + "\r";
-    TEInsert(line.c_str(), line.length(), data->logTE);
+    // Only queue here; FlushRedraws moves the batch into logTE once per
+    // event-loop pass.
+    Scrollback* sb = data->scrollback;
+    sb->Append(pieces);
+    if (data->logFile >= 0) {
+        // Logged as shown: formatting stripped
+        const char* text;
+        size_t length;
+        if (sb->GetLine(sb->EndLine() - 1, text, length)) {
+            logWriter.Append(data->logFile, { std::string_view(text, length) });
+        }
+    }
+    if (!data->dirty) {
+        data->dirty = true;
+        dirtyWindows.push_back(window);
+    }
+}
+
+void MacApp::FlushRedraws() {
+    if (dirtyWindows.empty()) return;
+
+    // A server batch (netsplit, netjoin, chathistory) is drawn in one go
+    // once it has all arrived, however many passes that takes. Only its
+    // own window waits, unless it has none; one whose end was lost stops
+    // holding after kBatchHoldMillis.
+    uint32_t now = ClockMillis();
+    bool holdAll = false;
+    size_t open = 0;
+    for (size_t i = 0; i < openBatches.size(); i++) {
+        if ((uint32_t)(now - openBatches[i].start) >= kBatchHoldMillis) {
+            if (openBatches[i].target != kNoIntern) irc.GetInterns().Release(openBatches[i].target);
+            continue;
+        }
+        if (openBatches[i].everyWindow) holdAll = true;
+        openBatches[open++] = openBatches[i];
+    }
+    openBatches.resize(open);
+    if (holdAll) {
+        redrawStats.batchHolds++;
+        return;
+    }
 
-    // Auto scroll to bottom
-    // Calculate difference between text height and view height
-    // TEScroll is tricky. Simplified:
-    // In a real app we'd verify line heights.
-    // For now, let's just trigger an update.
-    InvalRect(&window->portRect);
+    WindowPtr front = FrontWindow();
+    size_t kept = 0;
+    bool held = false;
+    for (size_t i = 0; i < dirtyWindows.size(); i++) {
+        WindowPtr window = dirtyWindows[i];
+        ChatWindowData* data = (ChatWindowData*)GetWRefCon(window);
+        if (!data) continue;
+
+        // Background windows stay queued until they come forward, paged
+        // ones until they return to the live view, and a batch's window
+        // until the batch ends
+        bool inBatch = false;
+        for (size_t b = 0; b < openBatches.size() && !inBatch; b++) {
+            inBatch = (openBatches[b].target == data->target);
+        }
+        held = held || inBatch;
+        if (window != front || data->history || inBatch) {
+            dirtyWindows[kept++] = window;
+            continue;
+        }
+        data->dirty = false;
+        FlushLogView(window, data);
+    }
+    dirtyWindows.resize(kept);
+    if (held) redrawStats.batchHolds++;
+
+    if ((uint32_t)(now - redrawStats.windowStart) >= 1000) {
+        redrawStats.repaintsPerSecond = redrawStats.windowRepaints;
+        redrawStats.pixelsPerSecond = redrawStats.windowPixels;
+        redrawStats.windowRepaints = 0;
+        redrawStats.windowPixels = 0;
+        redrawStats.windowStart = now;
+    }
+}
+
+// Moves queued scrollback lines into logTE with one TEStyleInsert and
+// invalidates only the rows they land on.
+void MacApp::FlushLogView(WindowPtr window, ChatWindowData* data) {
+    if (data->history) return;
+    Scrollback* sb = data->scrollback;
+    uint32_t end = sb->EndLine();
+    if (data->viewEndLine >= end) return;
+    PhaseScope timer(kPhaseRedraw);
+
+    TEHandle te = data->logTE;
+    Rect logRect = (*te)->viewRect;
+    uint32_t start = data->viewEndLine;
+    if (start < sb->FirstLine()) start = sb->FirstLine();
+
+    size_t bytes = 0;
+    const char* text;
+    size_t length;
+    for (uint32_t line = start; line < end; line++) {
+        if (sb->GetLine(line, text, length)) bytes += length + 1;
+    }
+
+    redrawStats.flushes++;
+    redrawStats.linesFlushed += end - start;
+    SetPort(window);
+
+    if (data->viewEndLine < sb->FirstLine() || (size_t)(*te)->teLength + bytes > kLogViewMaxBytes) {
+        RebuildLogView(data);
+        InvalidateLog(logRect);
+        return;
+    }
+
+    std::string& batch = viewScratch;
+    batch.clear();
+    styleScratch.clear();
+    const StyleRun* runs;
+    size_t runCount;
+    for (uint32_t line = start; line < end; line++) {
+        if (sb->GetLine(line, text, length, runs, runCount)) {
+            AddLineStyles(te, batch.size(), runs, runCount);
+            batch.append(text, length);
+            batch += '\r';
+        }
+    }
+
+    // Insert with drawing clipped away; the update event paints the new
+    // rows once.
+    int16_t oldLines = (*te)->nLines;
+    Rect noClip = { 0, 0, 0, 0 };
+    ClipRect(&noClip);
+    TESetSelect((*te)->teLength, (*te)->teLength, te);
+    InsertStyled(te, batch);
+    ClipRect(&window->portRect);
+    data->viewEndLine = end;
+
+    int16_t lineHeight = (*te)->lineHeight;
+    int16_t newLines = (*te)->nLines;
+    if (lineHeight <= 0 || newLines <= oldLines) {
+        InvalidateLog(logRect);
+        return;
+    }
+
+    // Keep the newest line at the bottom of the view
+    int16_t textBottom = (*te)->destRect.top + newLines * lineHeight;
+    if (textBottom > logRect.bottom) {
+        int16_t overflow = textBottom - logRect.bottom;
+        (*te)->destRect.top -= overflow;
+        (*te)->destRect.bottom -= overflow;
+        if (overflow >= logRect.bottom - logRect.top) {
+            InvalidateLog(logRect);
+        } else {
+            // Slide what is on screen up, then paint just the exposed rows
+            RgnHandle exposed = NewRgn();
+            ScrollRect(&logRect, 0, -overflow, exposed);
+            DisposeRgn(exposed);
+            Rect rows = logRect;
+            rows.top = logRect.bottom - overflow;
+            InvalidateLog(rows);
+        }
+    } else {
+        Rect rows = logRect;
+        rows.top = (*te)->destRect.top + oldLines * lineHeight;
+        rows.bottom = textBottom;
+        InvalidateLog(rows);
+    }
+}
+
+// Caller has already set the port
+void MacApp::InvalidateLog(const Rect& rect) {
+    InvalRect(&rect);
+    CountRedraw((unsigned long)(rect.right - rect.left) * (unsigned long)(rect.bottom - rect.top), false);
+}
+
+void MacApp::CountRedraw(unsigned long pixels, bool repaint) {
+    redrawStats.pixelsInvalidated += pixels;
+    redrawStats.windowPixels += pixels;
+    if (repaint) {
+        redrawStats.repaints++;
+        redrawStats.windowRepaints++;
+    }
+}
+
+// Reloads logTE with the most recent kLogViewKeepBytes of scrollback
+void MacApp::RebuildLogView(ChatWindowData* data) {
+    Scrollback* sb = data->scrollback;
+    uint32_t first = sb->EndLine();
+    size_t bytes = 0;
+    const char* text;
+    size_t length;
+
+    while (first > sb->FirstLine() && sb->GetLine(first - 1, text, length)) {
+        if (bytes + length + 1 > kLogViewKeepBytes) break;
+        bytes += length + 1;
+        first--;
+    }
+
+    std::string& view = viewScratch;
+    view.clear();
+    styleScratch.clear();
+    const StyleRun* runs;
+    size_t runCount;
+    for (uint32_t line = first; line < sb->EndLine(); line++) {
+        if (sb->GetLine(line, text, length, runs, runCount)) {
+            AddLineStyles(data->logTE, view.size(), runs, runCount);
+            view.append(text, length);
+            view += '\r';
+        }
+    }
+
+    TESetText(view.data(), 0, data->logTE);
+    InsertStyled(data->logTE, view);
+    data->viewFirstLine = first;
+    data->viewEndLine = sb->EndLine();
+}
+
+// Appends the TextEdit styles for a line starting at 'base' in a batch:
+// the default at its start, then one per run. Lines without runs after an
+// unstyled one add nothing.
+void MacApp::AddLineStyles(TEHandle te, size_t base, const StyleRun* runs, size_t runCount) {
+    for (size_t i = 0; i <= runCount; i++) {
+        const StyleRun* run = (i == 0) ? nullptr : &runs[i - 1];
+        ScrpSTElement style;
+        memset(&style, 0, sizeof(style));
+        style.scrpStartChar = (int32_t)(base + (run ? run->Start() : 0));
+        style.scrpHeight = (*te)->lineHeight;
+        style.scrpAscent = (*te)->fontAscent;
+        style.scrpFont = 0;
+        style.scrpSize = 12;
+        uint8_t color = 1;  // black
+        if (run) {
+            if (run->flags & kStyleMonospace) style.scrpFont = kMonacoFontID;
+            if (run->flags & kStyleBold) style.scrpFace |= bold;
+            if (run->flags & kStyleItalic) style.scrpFace |= italic;
+            if (run->flags & kStyleUnderline) style.scrpFace |= underline;
+            // No background in TextEdit: reverse can only show the
+            // background colour, when there is one
+            if (run->fg < 16) color = run->fg;
+            if ((run->flags & kStyleReverse) && run->bg < 16) color = run->bg;
+        }
+        style.scrpColor = kIRCColors[color];
+
+        if (!styleScratch.empty()) {
+            ScrpSTElement& last = styleScratch.back();
+            if (last.scrpFont == style.scrpFont && last.scrpFace == style.scrpFace &&
+                memcmp(&last.scrpColor, &style.scrpColor, sizeof(RGBColor)) == 0) {
+                continue;
+            }
+            if (last.scrpStartChar == style.scrpStartChar) {
+                last = style;
+                continue;
+            }
+        }
+        if (styleScratch.size() < kMaxScrapStyles) styleScratch.push_back(style);
+    }
+}
+
+// Inserts 'text' at logTE's selection styled by styleScratch, in one call
+void MacApp::InsertStyled(TEHandle te, const std::string& text) {
+    if (!styleScrap || styleScratch.empty()) {
+        TEInsert(text.data(), text.length(), te);
+        return;
+    }
+    size_t count = styleScratch.size();
+    SetHandleSize((Handle)styleScrap, (int32_t)(offsetof(StScrpRec, scrpStyleTab) + count * sizeof(ScrpSTElement)));
+    (*styleScrap)->scrpNStyles = (int16_t)count;
+    memcpy((*styleScrap)->scrpStyleTab, &styleScratch[0], count * sizeof(ScrpSTElement));
+    TEStyleInsert(text.data(), text.length(), styleScrap, te);
+}
+
+// Opens the window's log files for paging. The live view stays where it
+// was; liveStart is its first line, found by counting back from the end
+// of the log (flushed first so the two agree).
+bool MacApp::EnterHistory(ChatWindowData* data) {
+    if (data->history) return true;
+    if (data->logFile < 0) return false;
+
+    logWriter.Flush(data->logFile);
+    HistoryReader* history = new HistoryReader();
+    if (!history->Open(logWriter.Directory(), logWriter.FileName(data->logFile)) || history->SegmentCount() == 0) {
+        delete history;
+        return false;
+    }
+
+    HistoryPos pos = history->End();
+    std::string_view line;
+    Scrollback* sb = data->scrollback;
+    for (uint32_t n = data->viewFirstLine; n < sb->EndLine() && history->PrevLine(pos, line); n++) {
+    }
+
+    data->history = history;
+    data->liveStart = pos;
+    data->pageStart = pos;
+    data->pageEnd = pos;
+    return true;
+}
+
+// Back to the scrollback, caught up with whatever arrived meanwhile
+void MacApp::LeaveHistory(WindowPtr window, ChatWindowData* data) {
+    delete data->history;
+    data->history = nullptr;
+
+    SetPort(window);
+    RebuildLogView(data);
+    TEHandle te = data->logTE;
+    Rect logRect = (*te)->viewRect;
+    (*te)->destRect = logRect;
+    int16_t textBottom = logRect.top + (*te)->nLines * (*te)->lineHeight;
+    if (textBottom > logRect.bottom) {
+        (*te)->destRect.top -= textBottom - logRect.bottom;
+        (*te)->destRect.bottom -= textBottom - logRect.bottom;
+    }
+    InvalidateLog(logRect);
+}
+
+// Fills logTE with one screenful of history from 'start', stopping short
+// of what the live view already shows
+void MacApp::ShowHistoryPage(WindowPtr window, ChatWindowData* data, HistoryPos start) {
+    TEHandle te = data->logTE;
+    Rect logRect = (*te)->viewRect;
+    int16_t lineHeight = (*te)->lineHeight;
+    int lines = (lineHeight > 0) ? (logRect.bottom - logRect.top) / lineHeight : 1;
+    if (lines < 1) lines = 1;
+
+    HistoryReader* history = data->history;
+    std::string& view = viewScratch;
+    view.clear();
+    HistoryPos pos = start;
+    std::string_view line;
+    for (int n = 0; n < lines && view.size() < kLogViewMaxBytes; n++) {
+        if (!history->Settle(pos) || !(pos < data->liveStart)) break;
+        history->NextLine(pos, line);
+        view.append(line.data(), line.size());
+        view += '\r';
+    }
+
+    // Logs hold plain text
+    SetPort(window);
+    styleScratch.clear();
+    AddLineStyles(te, 0, nullptr, 0);
+    TESetText(view.data(), 0, te);
+    InsertStyled(te, view);
+    (*te)->destRect = logRect;
+    data->pageStart = start;
+    data->pageEnd = pos;
+    InvalidateLog(logRect);
+}
+
+void MacApp::PageHistory(WindowPtr window, ChatWindowData* data, char key) {
+    if (key == kEndKey) {
+        if (data->history) LeaveHistory(window, data);
+        return;
+    }
+    if (key == kPageDownKey && !data->history) return;
+    if (!EnterHistory(data)) return;
+
+    HistoryReader* history = data->history;
+    if (key == kHomeKey) {
+        ShowHistoryPage(window, data, history->Begin());
+    } else if (key == kPageUpKey) {
+        TEHandle te = data->logTE;
+        int16_t lineHeight = (*te)->lineHeight;
+        int lines = (lineHeight > 0) ? ((*te)->viewRect.bottom - (*te)->viewRect.top) / lineHeight : 1;
+        HistoryPos pos = data->pageStart;
+        std::string_view line;
+        for (int n = 0; n < lines && history->PrevLine(pos, line); n++) {
+        }
+        if (pos != data->pageStart) ShowHistoryPage(window, data, pos);
+    } else {
+        HistoryPos pos = data->pageEnd;
+        if (history->Settle(pos) && pos < data->liveStart) {
+            ShowHistoryPage(window, data, pos);
+        } else {
+            LeaveHistory(window, data);
+        }
+    }
+}
+
+// /history yyyy-mm-dd [hh:mm]
+void MacApp::SeekHistory(WindowPtr window, ChatWindowData* data, std::string_view args) {
+    std::string text(args);
+    int year, month, day, hour = 0, minute = 0;
+    int fields = sscanf(text.c_str(), " %d-%d-%d %d:%d", &year, &month, &day, &hour, &minute);
+    if (fields != 3 && fields != 5) {
+        AppendText(window, "Usage: /history yyyy-mm-dd [hh:mm]");
+        return;
+    }
+    if (!EnterHistory(data)) {
+        AppendText(window, "No history logged for this window");
+        return;
+    }
+
+    HistoryPos pos = data->history->Seek(year * 10000 + month * 100 + day, (uint32_t)(hour * 3600 + minute * 60));
+    if (data->history->Settle(pos) && pos < data->liveStart) {
+        ShowHistoryPage(window, data, pos);
+    } else {
+        LeaveHistory(window, data);
+    }
+}
+
+void MacApp::StartSearch(ChatWindowData* data, std::string_view args) {
+    std::string_view text = args;
+    while (!text.empty() && text[0] == ' ') text.remove_prefix(1);
+    bool all = text.substr(0, 5) == "-all " || text == "-all";
+    if (all) {
+        text.remove_prefix(4);
+        while (!text.empty() && text[0] == ' ') text.remove_prefix(1);
+    }
+    if (text.empty()) {
+        AppendText(data->window, "Usage: /search [-all] text");
+        return;
+    }
+
+    // One search at a time; a new one replaces it
+    if (!resultsWindow) resultsWindow = CreateResultsWindow();
+    search.Start(text);
+    searchLabels.clear();
+    if (all || data->type == kWindowTypeResults) {
+        if (statusWindow) AddSearchSource((ChatWindowData*)GetWRefCon(statusWindow));
+        for (size_t i = 0; i < windowsByTarget.size(); i++) {
+            if (windowsByTarget[i]) AddSearchSource(windowsByTarget[i]);
+        }
+    } else {
+        AddSearchSource(data);
+    }
+
+    AppendText(resultsWindow, { "Searching for \"", text, "\"", all ? " in all windows" : "" });
+    SelectWindow(resultsWindow);
+}
+
+void MacApp::AddSearchSource(ChatWindowData* data) {
+    std::string_view logName;
+    if (data->logFile >= 0) {
+        logWriter.Flush(data->logFile);
+        logName = logWriter.FileName(data->logFile);
+    }
+    search.AddSource(data->scrollback, logWriter.Directory(), logName);
+    if (data->type == kWindowTypeStatus) searchLabels.push_back("Status");
+    else searchLabels.push_back(std::string(irc.GetInterns().Name(data->target)));
+}
+
+// Hits go out as they are found; the summary follows the last slice
+void MacApp::StepSearch() {
+    if (!resultsWindow) {
+        search.Cancel();
+        return;
+    }
+
+    searchHits.clear();
+    bool more = search.Step(kSearchSliceMicros, searchHits);
+    for (size_t i = 0; i < searchHits.size(); i++) {
+        const SearchHit& hit = searchHits[i];
+        AppendText(resultsWindow, { searchLabels[hit.source], hit.fromLog ? " (log): " : ": ", hit.text });
+    }
+    if (more) return;
+
+    const SearchStats& stats = search.GetStats();
+    // Bytes per microsecond is MB/s; kept in tenths
+    unsigned long long rate = stats.micros ? (unsigned long long)stats.bytesScanned * 10 / stats.micros : 0;
+    char line[192];
+    snprintf(line, sizeof(line), "%lu matches%s; scanned %lu KB in %lu ms (%llu.%llu MB/s), index skipped %lu of %lu chunks",
+             stats.matches, stats.matches >= SearchJob::kMaxHits ? " (stopped)" : "", stats.bytesScanned / 1024,
+             (unsigned long)(stats.micros / 1000), rate / 10, rate % 10, stats.chunksSkipped,
+             stats.chunksSkipped + stats.chunksScanned);
+    AppendText(resultsWindow, line);
+    size_t live = scrollbackPool.LiveBytes();
+    snprintf(line, sizeof(line), "Index: %lu bytes, %lu%% of scrollback", (unsigned long)scrollbackPool.IndexBytes(),
+             live ? (unsigned long)(scrollbackPool.IndexBytes() * 100 / live) : 0UL);
+    AppendText(resultsWindow, line);
 }
 
 void MacApp::HandleInput(WindowPtr window) {
@@ -420,13 +1074,47 @@ void MacApp::HandleInput(WindowPtr window) {
              std::string chan = input.substr(6);
              irc.Join(chan);
         } else if (input.substr(0, 5) == "/part") {
-             irc.Part(data->target);
+             if (data->type == kWindowTypeChannel) irc.Part(irc.GetInterns().Name(data->target));
+        } else if (input.substr(0, 6) == "/stats") {
+            if (input.substr(6) == " reset") {
+                ResetPhaseStats();
+                AppendText(window, "Timing counters reset");
+            } else {
+                ShowPhaseStats();
+            }
+        } else if (input.substr(0, 5) == "/heap") {
+            ShowInternStats();
+            ShowHeapStats();
+        } else if (input.substr(0, 7) == "/search") {
+            StartSearch(data, std::string_view(input).substr(7));
+        } else if (input.substr(0, 9) == "/netsplit") {
+            ListNetsplits(window, data);
+        } else if (input.substr(0, 8) == "/history") {
+            SeekHistory(window, data, std::string_view(input).substr(8));
         } else if (input.substr(0, 4) == "/msg") {
             // /msg user text...
         }
+    } else if (input.find_first_of("\r\n") != std::string::npos) {
+        // Multi-line paste: queue it behind anything typed interactively
+        size_t start = 0;
+        while (start < input.length()) {
+            size_t end = input.find_first_of("\r\n", start);
+            if (end == std::string::npos) end = input.length();
+            if (end > start) {
+                std::string line = input.substr(start, end - start);
+                if (data->type == kWindowTypeChannel) {
+                    irc.PrivMsg(irc.GetInterns().Name(data->target), line, OutboundQueue::kPriorityBulk);
+                    AppendText(window, "<Me> " + line);
+                } else {
+                    irc.SendRaw(line, OutboundQueue::kPriorityBulk);
+                    AppendText(window, "> " + line);
+                }
+            }
+            start = end + 1;
+        }
     } else {
         if (data->type == kWindowTypeChannel) {
-            irc.PrivMsg(data->target, input);
+            irc.PrivMsg(irc.GetInterns().Name(data->target), input);
             AppendText(window, "<Me> " + input);
         } else {
             // Status window input? Raw command?
@@ -436,57 +1124,263 @@ void MacApp::HandleInput(WindowPtr window) {
     }
 }
 
-WindowPtr MacApp::FindWindowByTarget(const std::string& target) {
-    WindowPtr win = FrontWindow();
-    while (win != nil) {
-        ChatWindowData* data = (ChatWindowData*)GetWRefCon(win);
-        if (data && data->target == target) return win;
-        win = (WindowPtr)((WindowPeek)win)->nextWindow;
+// One line per phase into the status window
+void MacApp::ShowPhaseStats() {
+    if (!statusWindow) return;
+
+    // Snapshot first so the report's own appends don't show up in it
+    PhaseStats stats[kPhaseCount];
+    uint32_t p50[kPhaseCount], p90[kPhaseCount], p99[kPhaseCount];
+    for (int i = 0; i < kPhaseCount; i++) {
+        stats[i] = GetPhaseStats(i);
+        p50[i] = PhasePercentile(i, 50);
+        p90[i] = PhasePercentile(i, 90);
+        p99[i] = PhasePercentile(i, 99);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "Timings in us (per-line phases sampled 1 in %u):", kPhaseSampleInterval);
+    AppendText(statusWindow, line);
+    for (int i = 0; i < kPhaseCount; i++) {
+        const PhaseStats& s = stats[i];
+        unsigned long avg = s.samples ? (unsigned long)(s.totalMicros / s.samples) : 0;
+        snprintf(line, sizeof(line), "  %-10s n=%-8lu avg %-5lu min %-5lu max %-7lu p50<=%-5lu p90<=%-5lu p99<=%-6lu total %llu ms",
+                 PhaseName(i), s.samples, avg, (unsigned long)s.minMicros, (unsigned long)s.maxMicros,
+                 (unsigned long)p50[i], (unsigned long)p90[i], (unsigned long)p99[i], s.totalMicros / 1000);
+        AppendText(statusWindow, line);
     }
-    return nil;
+
+    const IRCClient::ReadStats& reads = irc.GetReadStats();
+    snprintf(line, sizeof(line), "  Reads: %lu busy ticks, %lu cut short by the budget, %lu lines, %lu events dropped",
+             reads.ticks, reads.budgetHits, reads.totalLines, reads.eventsDropped);
+    AppendText(statusWindow, line);
+
+    const LogWriter::Stats& logs = logWriter.GetStats();
+    snprintf(line, sizeof(line), "  Logs: %lu lines (%u/s), %lu blocks, %lu bytes, max stall %lu us, %lu forced, %lu lost",
+             logs.linesLogged, logs.linesPerSecond, logs.blocksWritten, logs.bytesWritten,
+             (unsigned long)logs.maxStallMicros, logs.forcedFlushes, logs.writeErrors);
+    AppendText(statusWindow, line);
 }
 
-// IRC Callbacks
-void MacApp::OnIRCLog(const std::string& text) {
-    // Find Status Window
-    WindowPtr win = FrontWindow();
-    // In a real app we keep a pointer to status window.
-    // Let's iterate.
-    while (win != nil) {
-        ChatWindowData* data = (ChatWindowData*)GetWRefCon(win);
-        if (data && data->type == kWindowTypeStatus) {
-            AppendText(win, text);
-            break;
+// Intern table size and hit rate into the status window
+void MacApp::ShowInternStats() {
+    if (!statusWindow) return;
+
+    const InternTable& interns = irc.GetInterns();
+    unsigned long lookups = interns.Lookups();
+    size_t entries = interns.Size();
+    char line[160];
+    snprintf(line, sizeof(line), "Interned names: %lu (%lu unreferenced), %lu bytes, %lu per entry, %lu%% of %lu lookups hit",
+             (unsigned long)entries, (unsigned long)interns.Unreferenced(), (unsigned long)interns.MemoryBytes(),
+             (unsigned long)(entries ? interns.MemoryBytes() / entries : 0),
+             lookups ? (unsigned long)((unsigned long long)interns.Hits() * 100 / lookups) : 0UL, lookups);
+    AppendText(statusWindow, line);
+}
+
+// One line per scope into the status window
+void MacApp::ShowHeapStats() {
+    if (!statusWindow) return;
+
+    char line[160];
+    if (!HeapStatsEnabled()) {
+        AppendText(statusWindow, "Heap statistics are not built in (configure with -DMIRC_HEAP_STATS=ON)");
+    } else {
+        // Snapshot first: formatting the report allocates too
+        HeapScopeStats totals = GetHeapTotals();
+        HeapScopeStats scopes[kHeapScopeCount];
+        for (int i = 0; i < kHeapScopeCount; i++) scopes[i] = GetHeapScopeStats(i);
+
+        snprintf(line, sizeof(line), "Heap: %lu allocs, %lu frees, %llu bytes total, %lu live, %lu peak",
+                 totals.allocs, totals.frees, totals.bytes, (unsigned long)totals.live, (unsigned long)totals.peak);
+        AppendText(statusWindow, line);
+        for (int i = 0; i < kHeapScopeCount; i++) {
+            const HeapScopeStats& s = scopes[i];
+            snprintf(line, sizeof(line), "  %-15s %8lu allocs %10llu bytes %8lu live %8lu peak",
+                     HeapScopeName(i), s.allocs, s.bytes, (unsigned long)s.live, (unsigned long)s.peak);
+            AppendText(statusWindow, line);
         }
-        win = (WindowPtr)((WindowPeek)win)->nextWindow;
     }
+
+    // The arena and name pool count for themselves, heap stats or not.
+    // The arena is reset once per line, so its resets are lines handled.
+    const LineArena& arena = irc.GetLineArena();
+    unsigned long arenaLines = arena.Resets();
+    snprintf(line, sizeof(line), "Line arena: %lu of %lu bytes peak, %lu heap overflows (%.1f per 10k lines)",
+             (unsigned long)arena.Peak(), (unsigned long)arena.BlockSize(), arena.OverflowAllocs(),
+             arenaLines ? 10000.0 * arena.OverflowAllocs() / arenaLines : 0.0);
+    AppendText(statusWindow, line);
+    const NamePool& names = irc.GetNamePool();
+    snprintf(line, sizeof(line), "Name pool: %u/%u/%u slots of %lu/%lu/%lu bytes, %lu slab bytes, %lu heap fallbacks",
+             names.SlotsInUse(0), names.SlotsInUse(1), names.SlotsInUse(2), (unsigned long)NamePool::SlotSize(0),
+             (unsigned long)NamePool::SlotSize(1), (unsigned long)NamePool::SlotSize(2),
+             (unsigned long)names.SlabBytes(), names.HeapFallbacks());
+    AppendText(statusWindow, line);
+}
+
+WindowPtr MacApp::FindWindowByTarget(IRCTarget target) {
+    // Every window's name is interned, so a name without an id has none
+    if (target.id >= windowsByTarget.size()) return nil;
+    ChatWindowData* data = windowsByTarget[target.id];
+    return data ? data->window : nil;
 }
 
-void MacApp::OnIRCMessage(const std::string& target, const std::string& sender, const std::string& text) {
-    std::string winTarget = (target[0] == '#') ? target : sender;
+// IRC Callbacks
+void MacApp::OnIRCLog(std::string_view text) {
+    if (statusWindow) AppendText(statusWindow, text);
+}
 
-    WindowPtr win = FindWindowByTarget(winTarget);
+void MacApp::OnIRCMessage(IRCTarget target, std::string_view sender, std::string_view text, const IRCTags& tags) {
+    WindowPtr win = FindWindowByTarget(target);
     if (!win) {
         // Open new window for private message?
-        if (winTarget[0] != '#') {
-             win = CreateChannelWindow(winTarget); // Reuse channel window logic for PM
+        if (!target.name.empty() && target.name[0] != '#') {
+             win = CreateChannelWindow(target.name); // Reuse channel window logic for PM
         }
     }
 
+    // Lines replayed in a batch (chathistory) show when they were said,
+    // converted from the server's UTC stamp
+    char stamp[12];
+    stamp[0] = 0;
+    IRCServerTime time;
+    if (!tags.batch.empty() && ParseIRCServerTime(tags.time, time)) {
+        int32_t second = ((time.hour * 60 + time.minute) * 60 + time.second + ClockUTCOffset()) % 86400;
+        if (second < 0) second += 86400;
+        snprintf(stamp, sizeof(stamp), "[%02d:%02d] ", (int)(second / 3600), (int)(second / 60 % 60));
+    }
+
+    // Formatted straight into the scrollback: no heap traffic per message
     if (win) {
-        AppendText(win, "<" + sender + "> " + text);
-    } else {
-        OnIRCLog(sender + " says: " + text);
+        AppendText(win, { stamp, "<", sender, "> ", text });
+    } else if (statusWindow) {
+        AppendText(statusWindow, { sender, " says: ", text });
     }
 }
 
-void MacApp::OnIRCJoin(const std::string& channel) {
-    CreateChannelWindow(channel);
+void MacApp::OnIRCJoin(IRCTarget channel, std::string_view nick, bool self) {
+    // Only our own JOIN opens a window
+    WindowPtr win = FindWindowByTarget(channel);
+    if (self) {
+        if (!win) CreateChannelWindow(channel.name);
+    } else if (win) {
+        AppendText(win, { "* ", nick, " has joined" });
+    }
 }
 
-void MacApp::OnIRCPart(const std::string& channel) {
+void MacApp::OnIRCPart(IRCTarget channel, std::string_view nick, std::string_view reason, bool self) {
     WindowPtr win = FindWindowByTarget(channel);
-    if (win) {
+    if (!win) return;
+    if (self) {
         DisposeChatWindow(win);
+    } else if (reason.empty()) {
+        AppendText(win, { "* ", nick, " has left" });
+    } else {
+        AppendText(win, { "* ", nick, " has left (", reason, ")" });
     }
 }
+
+void MacApp::OnIRCQuit(IRCTarget channel, std::string_view nick, std::string_view reason) {
+    WindowPtr win = FindWindowByTarget(channel);
+    if (win) AppendText(win, { "* ", nick, " has quit (", reason, ")" });
+}
+
+void MacApp::OnIRCNick(IRCTarget channel, std::string_view oldNick, std::string_view newNick, bool self) {
+    WindowPtr win = FindWindowByTarget(channel);
+    if (!win) return;
+    if (self) AppendText(win, { "* You are now known as ", newNick });
+    else AppendText(win, { "* ", oldNick, " is now known as ", newNick });
+}
+
+void MacApp::OnIRCBatchStart(std::string_view type, IRCTarget target) {
+    (void)type;
+    BatchHold hold = { target.id, FindWindowByTarget(target) == nil, ClockMillis() };
+    // Kept alive until the end, so a prune cannot hand the id to another name
+    if (hold.target != kNoIntern) irc.GetInterns().Retain(hold.target);
+    openBatches.push_back(hold);
+}
+
+void MacApp::OnIRCBatchEnd(std::string_view type, IRCTarget target) {
+    (void)type;
+    // Innermost first: nested batches usually share a target
+    for (size_t i = openBatches.size(); i-- > 0;) {
+        if (openBatches[i].target != target.id) continue;
+        if (target.id != kNoIntern) irc.GetInterns().Release(target.id);
+        openBatches.erase(openBatches.begin() + i);
+        return;
+    }
+}
+
+void MacApp::ClearBatchHolds() {
+    for (size_t i = 0; i < openBatches.size(); i++) {
+        if (openBatches[i].target != kNoIntern) irc.GetInterns().Release(openBatches[i].target);
+    }
+    openBatches.clear();
+}
+
+void MacApp::OnIRCNetsplit(IRCTarget channel, std::string_view servers, uint32_t count, bool rejoined) {
+    WindowPtr win = FindWindowByTarget(channel);
+    if (!win) return;
+
+    size_t space = servers.find(' ');
+    std::string_view near = servers.substr(0, space);
+    std::string_view far = (space == std::string_view::npos) ? std::string_view() : servers.substr(space + 1);
+    char users[48];
+    snprintf(users, sizeof(users), "%lu user%s", (unsigned long)count, count == 1 ? "" : "s");
+    if (rejoined) {
+        AppendText(win, { "* Netsplit over ", near, " <-> ", far, ": ", users, " rejoined" });
+    } else {
+        AppendText(win, { "* Netsplit ", near, " <-> ", far, ": ", users, " quit (/netsplit lists them)" });
+    }
+}
+
+// Lists, per remembered split, the nicks that left this channel in it,
+// wrapped into lines and marking who has come back
+void MacApp::ListNetsplits(WindowPtr window, ChatWindowData* data) {
+    if (data->type != kWindowTypeChannel) {
+        AppendText(window, "Usage: /netsplit in a channel window");
+        return;
+    }
+    const NetsplitTracker& splits = irc.GetNetsplits();
+    const InternTable& interns = irc.GetInterns();
+    const size_t kLineLength = 240;
+    bool any = false;
+    std::string line;
+    for (size_t g = 0; g < splits.GroupCount(); g++) {
+        const NetsplitTracker::Group& group = splits.GroupAt(g);
+        size_t count = 0;
+        line.clear();
+        for (size_t i = 0; i < group.entries.size(); i++) {
+            const NetsplitTracker::Entry& entry = group.entries[i];
+            if (entry.channel != data->target) continue;
+            if (count == 0) line = "* Netsplit " + group.servers + ":";
+            if (line.size() > kLineLength) {
+                AppendText(window, line);
+                line = "*  ";
+            }
+            line += ' ';
+            if (entry.rejoined) line += '+';
+            line.append(interns.Name(entry.nick).data(), interns.Name(entry.nick).size());
+            count++;
+        }
+        if (count == 0) continue;
+        AppendText(window, line);
+        any = true;
+    }
+    AppendText(window, any ? "* (+ has rejoined)" : "* No recent netsplits here");
+}
+
+void MacApp::OnIRCNames(IRCTarget channel) {
+    WindowPtr win = FindWindowByTarget(channel);
+    const Membership& members = irc.GetMembership();
+    int id = members.FindChannel(channel.id);
+    if (!win || id < 0) return;
+
+    int opBit = members.PrefixBitForMode('o');
+    int voiceBit = members.PrefixBitForMode('v');
+    char line[96];
+    snprintf(line, sizeof(line), "* %lu users, %lu ops, %lu voiced",
+             (unsigned long)members.MemberCount(id),
+             (unsigned long)(opBit >= 0 ? members.CountWithPrefix(id, opBit) : 0),
+             (unsigned long)(voiceBit >= 0 ? members.CountWithPrefix(id, voiceBit) : 0));
+    AppendText(win, line);
+}
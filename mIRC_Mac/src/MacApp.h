@@ -16,20 +16,67 @@
     #include <Dialogs.h>
 #endif
 
+#include "History.h"
 #include "IRCClient.h"
+#include "LogWriter.h"
+#include "Scrollback.h"
+#include "Search.h"
 #include <map>
 #include <string>
+#include <vector>
 
 // Window Types
 const int kWindowTypeStatus = 1;
 const int kWindowTypeChannel = 2;
+const int kWindowTypeResults = 3;
 
 struct ChatWindowData {
+    WindowPtr window;
     int type;
-    std::string target; // Channel name or "" for status
+    InternId target;         // Channel or nick; kNoIntern for status
     TEHandle logTE;
     TEHandle inputTE;
     ControlHandle scrollBar; // For future expansion
+    Scrollback* scrollback;  // Source of truth for the log
+    uint32_t viewFirstLine;  // First scrollback line currently in logTE
+    uint32_t viewEndLine;    // Lines from here on are queued, not yet in logTE
+    bool dirty;              // On MacApp's dirty list
+    int logFile;             // LogWriter handle, -1 if not logged
+    HistoryReader* history;  // Non-null while paged back into the log files
+    HistoryPos pageStart;    // Lines of history now in logTE
+    HistoryPos pageEnd;
+    HistoryPos liveStart;    // Where the live view began when paging started
+};
+
+// An open IRCv3 batch, holding back its window's redraws until its end
+struct BatchHold {
+    InternId target;      // the batch's first parameter, as interned; held
+    bool everyWindow;     // no window of its own (netsplit, netjoin): hold all
+    uint32_t start;       // ClockMillis() when it began
+};
+
+// Event-loop wake-up accounting, for checking the idle strategy
+struct LoopStats {
+    unsigned long wakeups;       // passes through the event loop
+    unsigned long busyWakeups;   // passes that found network or user work
+    unsigned wakeupsPerSecond;   // over the last full second
+    unsigned sleepTicks;         // current WaitNextEvent sleep
+    uint32_t windowStart;        // start of the current one-second window
+    unsigned windowWakeups;
+};
+
+// Repaint accounting, for checking the deferred redraw during floods
+struct RedrawStats {
+    unsigned long flushes;        // batches moved from scrollback into logTE
+    unsigned long linesFlushed;
+    unsigned long batchHolds;     // passes that left the flush to a batch's end
+    unsigned long repaints;       // update events handled
+    unsigned long pixelsInvalidated;
+    unsigned repaintsPerSecond;   // over the last full second
+    unsigned long pixelsPerSecond;
+    uint32_t windowStart;
+    unsigned windowRepaints;
+    unsigned long windowPixels;
 };
 
 class MacApp {
@@ -40,9 +87,44 @@ public:
     void Init();
     void Run();
 
+    const LoopStats& GetLoopStats() const { return loopStats; }
+    const RedrawStats& GetRedrawStats() const { return redrawStats; }
+
+    // IRCClient event sink, bound at compile time by irc.Update(*this)
+    void OnIRCLog(std::string_view text);
+    void OnIRCMessage(IRCTarget target, std::string_view sender, std::string_view text, const IRCTags& tags);
+    void OnIRCJoin(IRCTarget channel, std::string_view nick, bool self);
+    void OnIRCPart(IRCTarget channel, std::string_view nick, std::string_view reason, bool self);
+    void OnIRCQuit(IRCTarget channel, std::string_view nick, std::string_view reason);
+    void OnIRCNick(IRCTarget channel, std::string_view oldNick, std::string_view newNick, bool self);
+    void OnIRCNames(IRCTarget channel);
+    void OnIRCBatchStart(std::string_view type, IRCTarget target);
+    void OnIRCBatchEnd(std::string_view type, IRCTarget target);
+    void OnIRCNetsplit(IRCTarget channel, std::string_view servers, uint32_t count, bool rejoined);
+
 private:
     bool running;
     IRCClient irc;
+    LoopStats loopStats;
+    ScrollbackPool scrollbackPool;
+    RedrawStats redrawStats;
+    std::vector<WindowPtr> dirtyWindows;
+    std::vector<BatchHold> openBatches;  // redraws they cover wait for the end
+    std::string viewScratch; // reused to build logTE text batches
+    std::vector<ScrpSTElement> styleScratch;  // and their styles
+    StScrpHandle styleScrap;
+    LogWriter logWriter;
+
+    // /search in progress, its hits going to resultsWindow
+    SearchJob search;
+    std::vector<std::string> searchLabels;  // by source
+    std::vector<SearchHit> searchHits;      // reused each slice
+    WindowPtr resultsWindow;
+
+    // Routing: target InternId -> window (null where none), plus the
+    // status window. Each window holds a reference on its id.
+    std::vector<ChatWindowData*> windowsByTarget;
+    WindowPtr statusWindow;
 
     // GUI Helpers
     void InitializeToolbox();
@@ -55,23 +137,48 @@ private:
     void DoUpdate(EventRecord& event);
     void DoActivate(EventRecord& event);
     void DoMenuCommand(long menuResult);
+    uint32_t NextSleepTicks(bool active);
 
     // Window Management
     WindowPtr CreateStatusWindow();
-    WindowPtr CreateChannelWindow(const std::string& name);
+    WindowPtr CreateChannelWindow(std::string_view name);
+    WindowPtr CreateResultsWindow();
     void ResizeWindow(WindowPtr window, Point newSize);
     void DisposeChatWindow(WindowPtr window);
 
     // Chat Logic
-    void AppendText(WindowPtr window, const std::string& text);
+    void AppendText(WindowPtr window, std::string_view text);
+    // Formats the line directly into the window's scrollback
+    void AppendText(WindowPtr window, std::initializer_list<std::string_view> pieces);
+    void RebuildLogView(ChatWindowData* data);
+    void AddLineStyles(TEHandle te, size_t base, const StyleRun* runs, size_t runCount);
+    void InsertStyled(TEHandle te, const std::string& text);
+    void FlushRedraws();
+    void ClearBatchHolds();
+    void FlushLogView(WindowPtr window, ChatWindowData* data);
+    void InvalidateLog(const Rect& rect);
+    void CountRedraw(unsigned long pixels, bool repaint);
     void HandleInput(WindowPtr window);
-    WindowPtr FindWindowByTarget(const std::string& target);
 
-    // IRC Callbacks
-    void OnIRCLog(const std::string& text);
-    void OnIRCMessage(const std::string& target, const std::string& sender, const std::string& text);
-    void OnIRCJoin(const std::string& channel);
-    void OnIRCPart(const std::string& channel);
+    // History paging: Page Up/Down, Home/End and /history
+    bool EnterHistory(ChatWindowData* data);
+    void LeaveHistory(WindowPtr window, ChatWindowData* data);
+    void PageHistory(WindowPtr window, ChatWindowData* data, char key);
+    void ShowHistoryPage(WindowPtr window, ChatWindowData* data, HistoryPos start);
+    void SeekHistory(WindowPtr window, ChatWindowData* data, std::string_view args);
+
+    // /netsplit: who left this channel in the remembered splits
+    void ListNetsplits(WindowPtr window, ChatWindowData* data);
+
+    // /search [-all] text
+    void StartSearch(ChatWindowData* data, std::string_view args);
+    void AddSearchSource(ChatWindowData* data);
+    void StepSearch();
+
+    void ShowPhaseStats();
+    void ShowHeapStats();
+    void ShowInternStats();
+    WindowPtr FindWindowByTarget(IRCTarget target);
 };
 
 #endif // MAC_APP_H
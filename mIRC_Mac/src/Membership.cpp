@@ -0,0 +1,446 @@
+#include "Membership.h"
+#include <algorithm>
+
+// Until ISUPPORT says otherwise (RFC 1459 servers)
+static const char* const kDefaultPrefix = "(ov)@+";
+static const char* const kDefaultChanModes = "beI,k,l,imnpst";
+
+// Member order: by folded nick
+struct MemberLess {
+    const InternTable& names;
+    CaseMapping mapping;
+
+    bool operator()(const Membership::Member& a, const Membership::Member& b) const {
+        return IRCCompare(names.Name(a.user), names.Name(b.user), mapping) < 0;
+    }
+};
+
+Membership::Membership(InternTable& interns)
+    : interns(interns), mapping(CaseMapping::Rfc1459), userCount(0) {
+    for (int i = 0; i < kMaxChannels; i++) channels[i] = nullptr;
+    SetPrefixes(kDefaultPrefix);
+    SetChannelModes(kDefaultChanModes);
+}
+
+Membership::~Membership() {
+    Clear();
+}
+
+void Membership::Clear() {
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (channels[i]) RemoveChannel(i);
+    }
+    userChannels.clear();
+    userCount = 0;
+    SetPrefixes(kDefaultPrefix);
+    SetChannelModes(kDefaultChanModes);
+}
+
+void Membership::SetCaseMapping(CaseMapping newMapping) {
+    if (newMapping == mapping) return;
+    mapping = newMapping;
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (channels[i]) Sort(channels[i]->members);
+    }
+}
+
+void Membership::SetPrefixes(std::string_view value) {
+    size_t close = value.find(')');
+    if (value.empty() || value[0] != '(' || close == std::string_view::npos) return;
+
+    std::string_view modes = value.substr(1, close - 1);
+    std::string_view symbols = value.substr(close + 1);
+    size_t count = std::min(std::min(modes.size(), symbols.size()), (size_t)kMaxPrefixes);
+    prefixModes.assign(modes.data(), count);
+    prefixSymbols.assign(symbols.data(), count);
+}
+
+void Membership::SetChannelModes(std::string_view value) {
+    // A,B,C,D: A and B always take a parameter, C only when being set
+    paramModes.clear();
+    setParamModes.clear();
+    int type = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        char c = value[i];
+        if (c == ',') {
+            type++;
+        } else if (type <= 1) {
+            paramModes += c;
+        } else if (type == 2) {
+            setParamModes += c;
+        }
+    }
+}
+
+// Channels
+
+int Membership::AddChannel(std::string_view name) {
+    int existing = FindChannel(name);
+    if (existing >= 0) return existing;
+
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (channels[i]) continue;
+        Channel* channel = new Channel();
+        channel->name = interns.Acquire(name);
+        channel->inNames = false;
+        channels[i] = channel;
+        return i;
+    }
+    return -1;
+}
+
+void Membership::RemoveChannel(int channel) {
+    Channel* c = channels[channel];
+    if (!c) return;
+
+    uint32_t bit = 1u << channel;
+    for (size_t i = 0; i < c->members.size(); i++) {
+        InternId user = c->members[i].user;
+        SetChannels(user, ChannelsOf(user) & ~bit);
+        interns.Release(user);
+    }
+    for (size_t i = 0; i < c->pending.size(); i++) interns.Release(c->pending[i].user);
+
+    interns.Release(c->name);
+    channels[channel] = nullptr;
+    delete c;
+}
+
+int Membership::FindChannel(std::string_view name) const {
+    InternId id = interns.Find(name);
+    return (id == kNoIntern) ? -1 : FindChannel(id);
+}
+
+int Membership::FindChannel(InternId name) const {
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (channels[i] && channels[i]->name == name) return i;
+    }
+    return -1;
+}
+
+InternId Membership::ChannelId(int channel) const {
+    return channels[channel] ? channels[channel]->name : kNoIntern;
+}
+
+std::string_view Membership::ChannelName(int channel) const {
+    return channels[channel] ? interns.Name(channels[channel]->name) : std::string_view();
+}
+
+// Users
+
+void Membership::SetChannels(InternId user, uint32_t mask) {
+    if (user >= userChannels.size()) {
+        if (!mask) return;
+        userChannels.resize(interns.Capacity(), 0);
+    }
+    uint32_t& current = userChannels[user];
+    if (!current && mask) userCount++;
+    else if (current && !mask) userCount--;
+    current = mask;
+}
+
+uint32_t Membership::ChannelsOf(std::string_view nick) const {
+    InternId user = interns.Find(nick);
+    return (user == kNoIntern) ? 0 : ChannelsOf(user);
+}
+
+size_t Membership::LowerBound(const Channel& channel, std::string_view nick) const {
+    size_t lo = 0, hi = channel.members.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (IRCCompare(interns.Name(channel.members[mid].user), nick, mapping) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+Membership::Member* Membership::FindMember(Channel& channel, std::string_view nick) {
+    size_t at = LowerBound(channel, nick);
+    if (at == channel.members.size()) return nullptr;
+    Member& member = channel.members[at];
+    return IRCEquals(interns.Name(member.user), nick, mapping) ? &member : nullptr;
+}
+
+size_t Membership::IndexOf(const Channel& channel, InternId user, std::string_view nick) const {
+    const std::vector<Member>& members = channel.members;
+    for (size_t at = LowerBound(channel, nick);
+         at < members.size() && IRCEquals(interns.Name(members[at].user), nick, mapping); at++) {
+        if (members[at].user == user) return at;
+    }
+    return members.size();
+}
+
+void Membership::AddMember(int channel, std::string_view nick, uint8_t prefixes) {
+    Channel* c = channels[channel];
+    if (!c || nick.empty()) return;
+
+    Member* existing = FindMember(*c, nick);
+    if (existing) {
+        existing->prefixes |= prefixes;
+        return;
+    }
+
+    Member member = { interns.Acquire(nick), prefixes };
+    SetChannels(member.user, ChannelsOf(member.user) | (1u << channel));
+    c->members.insert(c->members.begin() + LowerBound(*c, nick), member);
+}
+
+bool Membership::RemoveMember(int channel, std::string_view nick) {
+    Channel* c = channels[channel];
+    if (!c) return false;
+
+    size_t at = LowerBound(*c, nick);
+    if (at == c->members.size() || !IRCEquals(interns.Name(c->members[at].user), nick, mapping)) return false;
+
+    InternId user = c->members[at].user;
+    c->members.erase(c->members.begin() + at);
+    SetChannels(user, ChannelsOf(user) & ~(1u << channel));
+    interns.Release(user);
+    return true;
+}
+
+uint32_t Membership::RemoveUser(std::string_view nick) {
+    InternId user = interns.Find(nick);
+    uint32_t mask = (user == kNoIntern) ? 0 : ChannelsOf(user);
+    if (!mask) return 0;
+
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (!(mask & (1u << i)) || !channels[i]) continue;
+        size_t at = IndexOf(*channels[i], user, nick);
+        if (at == channels[i]->members.size()) continue;
+        channels[i]->members.erase(channels[i]->members.begin() + at);
+        interns.Release(user);
+    }
+    SetChannels(user, 0);
+    return mask;
+}
+
+uint32_t Membership::RemoveUsers(const InternId* users, size_t count, uint32_t* masks) {
+    uint32_t all = 0;
+    for (size_t i = 0; i < count; i++) {
+        masks[i] = ChannelsOf(users[i]);
+        all |= masks[i];
+        SetChannels(users[i], 0);
+    }
+
+    // Whoever has lost a channel's bit goes from its array
+    for (int i = 0; i < kMaxChannels; i++) {
+        uint32_t bit = 1u << i;
+        if (!(all & bit) || !channels[i]) continue;
+        std::vector<Member>& members = channels[i]->members;
+        size_t kept = 0;
+        for (size_t m = 0; m < members.size(); m++) {
+            if (ChannelsOf(members[m].user) & bit) members[kept++] = members[m];
+            else interns.Release(members[m].user);
+        }
+        members.resize(kept);
+    }
+    return all;
+}
+
+void Membership::AddMembers(int channel, const InternId* users, size_t count) {
+    Channel* c = channels[channel];
+    if (!c) return;
+
+    uint32_t bit = 1u << channel;
+    size_t old = c->members.size();
+    for (size_t i = 0; i < count; i++) {
+        InternId user = users[i];
+        if (ChannelsOf(user) & bit) continue;
+        interns.Retain(user);
+        SetChannels(user, ChannelsOf(user) | bit);
+        Member member = { user, 0 };
+        c->members.push_back(member);
+    }
+    if (c->members.size() == old) return;
+
+    MemberLess less = { interns, mapping };
+    std::sort(c->members.begin() + old, c->members.end(), less);
+    std::inplace_merge(c->members.begin(), c->members.begin() + old, c->members.end(), less);
+}
+
+uint32_t Membership::RenameUser(std::string_view oldNick, std::string_view newNick) {
+    InternId user = interns.Find(oldNick);
+    uint32_t mask = (user == kNoIntern) ? 0 : ChannelsOf(user);
+    if (!mask || newNick.empty()) return 0;
+
+    // Pull the member out of each sorted array, rename, then put it back
+    uint8_t prefixes[kMaxChannels];
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (!(mask & (1u << i)) || !channels[i]) continue;
+        std::vector<Member>& members = channels[i]->members;
+        size_t at = IndexOf(*channels[i], user, oldNick);
+        if (at == members.size()) {
+            // Not really there; leave the channel out of the rename
+            mask &= ~(1u << i);
+            continue;
+        }
+        prefixes[i] = members[at].prefixes;
+        members.erase(members.begin() + at);
+    }
+    SetChannels(user, mask);
+    if (!mask) return 0;
+
+    InternId renamed = interns.Find(newNick);
+    if (renamed == user) {
+        // Only the case changed: same id, new spelling
+        interns.Respell(user, newNick);
+    } else {
+        // A stale record already holding the new nick (we missed its QUIT)
+        if (renamed != kNoIntern) RemoveUser(newNick);
+        renamed = interns.Acquire(newNick);
+        for (int i = 0; i < kMaxChannels; i++) {
+            if (!(mask & (1u << i)) || !channels[i]) continue;
+            interns.Retain(renamed);
+            interns.Release(user);
+        }
+        interns.Release(renamed);
+        SetChannels(user, 0);
+        SetChannels(renamed, mask);
+    }
+
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (!(mask & (1u << i)) || !channels[i]) continue;
+        Member member = { renamed, prefixes[i] };
+        std::vector<Member>& members = channels[i]->members;
+        members.insert(members.begin() + LowerBound(*channels[i], newNick), member);
+    }
+    return mask;
+}
+
+// Modes
+
+int Membership::PrefixBitForMode(char mode) const {
+    size_t at = prefixModes.find(mode);
+    return (at == std::string::npos) ? -1 : (int)at;
+}
+
+bool Membership::ModeTakesParam(char mode, bool adding) const {
+    if (PrefixBitForMode(mode) >= 0) return true;
+    if (paramModes.find(mode) != std::string::npos) return true;
+    return adding && setParamModes.find(mode) != std::string::npos;
+}
+
+void Membership::SetMemberPrefix(int channel, std::string_view nick, int bit, bool set) {
+    Channel* c = channels[channel];
+    if (!c || bit < 0 || bit >= kMaxPrefixes) return;
+    Member* member = FindMember(*c, nick);
+    if (!member) return;
+    if (set) member->prefixes |= (uint8_t)(1u << bit);
+    else member->prefixes &= (uint8_t)~(1u << bit);
+}
+
+char Membership::PrefixSymbol(uint8_t prefixes) const {
+    for (size_t i = 0; i < prefixSymbols.size(); i++) {
+        if (prefixes & (1u << i)) return prefixSymbols[i];
+    }
+    return 0;
+}
+
+// NAMES
+
+void Membership::AddNames(int channel, std::string_view list) {
+    Channel* c = channels[channel];
+    if (!c) return;
+    if (!c->inNames) {
+        c->inNames = true;
+        c->pending.clear();
+    }
+
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(' ', pos);
+        if (end == std::string_view::npos) end = list.size();
+        std::string_view entry = list.substr(pos, end - pos);
+        pos = end + 1;
+
+        // "@+nick" with multi-prefix, "nick!user@host" with userhost-in-names
+        uint8_t prefixes = 0;
+        size_t skip = 0;
+        while (skip < entry.size()) {
+            size_t bit = prefixSymbols.find(entry[skip]);
+            if (bit == std::string::npos) break;
+            prefixes |= (uint8_t)(1u << bit);
+            skip++;
+        }
+        std::string_view nick = entry.substr(skip);
+        nick = nick.substr(0, nick.find('!'));
+        if (nick.empty()) continue;
+
+        Member member = { interns.Acquire(nick), prefixes };
+        c->pending.push_back(member);
+    }
+}
+
+void Membership::Sort(std::vector<Member>& members) const {
+    MemberLess less = { interns, mapping };
+    std::sort(members.begin(), members.end(), less);
+}
+
+void Membership::EndNames(int channel) {
+    Channel* c = channels[channel];
+    if (!c || !c->inNames) return;
+    c->inNames = false;
+
+    // Sort once, folding duplicates (a user listed twice keeps both prefixes)
+    Sort(c->pending);
+    size_t kept = 0;
+    for (size_t i = 0; i < c->pending.size(); i++) {
+        if (kept && c->pending[kept - 1].user == c->pending[i].user) {
+            c->pending[kept - 1].prefixes |= c->pending[i].prefixes;
+            interns.Release(c->pending[i].user);
+        } else {
+            c->pending[kept++] = c->pending[i];
+        }
+    }
+    c->pending.resize(kept);
+
+    uint32_t bit = 1u << channel;
+    for (size_t i = 0; i < c->members.size(); i++) {
+        InternId user = c->members[i].user;
+        SetChannels(user, ChannelsOf(user) & ~bit);
+    }
+    for (size_t i = 0; i < c->pending.size(); i++) {
+        InternId user = c->pending[i].user;
+        SetChannels(user, ChannelsOf(user) | bit);
+    }
+
+    // The previous list gives up its references; keep its buffer for next time
+    c->members.swap(c->pending);
+    for (size_t i = 0; i < c->pending.size(); i++) interns.Release(c->pending[i].user);
+    c->pending.clear();
+}
+
+// Queries
+
+size_t Membership::MemberCount(int channel) const {
+    return channels[channel] ? channels[channel]->members.size() : 0;
+}
+
+const Membership::Member& Membership::MemberAt(int channel, size_t index) const {
+    return channels[channel]->members[index];
+}
+
+std::string_view Membership::NickOf(const Member& member) const {
+    return interns.Name(member.user);
+}
+
+size_t Membership::CountWithPrefix(int channel, int bit) const {
+    Channel* c = channels[channel];
+    if (!c) return 0;
+    size_t count = 0;
+    for (size_t i = 0; i < c->members.size(); i++) {
+        if (c->members[i].prefixes & (1u << bit)) count++;
+    }
+    return count;
+}
+
+size_t Membership::MemoryBytes() const {
+    size_t bytes = userChannels.capacity() * sizeof(uint32_t);
+    for (int i = 0; i < kMaxChannels; i++) {
+        if (!channels[i]) continue;
+        bytes += sizeof(Channel);
+        bytes += (channels[i]->members.capacity() + channels[i]->pending.capacity()) * sizeof(Member);
+    }
+    return bytes;
+}
@@ -0,0 +1,125 @@
+#ifndef MEMBERSHIP_H
+#define MEMBERSHIP_H
+
+#include "CaseMap.h"
+#include "InternTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Who is in which of our channels. Nicks and channel names live in the
+// session's InternTable; a channel is a sorted array of 8-byte Members
+// (intern id + prefix bits), so a 5000-user channel costs about 40K plus
+// the nicks. Every nick's id also indexes a bitmask of the channels it
+// shares with us, which makes QUIT and NICK O(channels-of-user) instead
+// of a scan of every channel. Each Member holds a reference on its id.
+class Membership {
+public:
+    // One bit per joined channel in User::channels
+    static const int kMaxChannels = 32;
+    // Bit i of Member::prefixes is the i-th PREFIX mode, 0 being highest
+    static const int kMaxPrefixes = 8;
+
+    struct Member {
+        InternId user;
+        uint8_t prefixes;
+    };
+
+    explicit Membership(InternTable& interns);
+    ~Membership();
+
+    // Forgets everything (disconnect); ISUPPORT settings revert to defaults
+    void Clear();
+
+    void SetCaseMapping(CaseMapping mapping);
+    // ISUPPORT PREFIX, e.g. "(qaohv)~&@%+"
+    void SetPrefixes(std::string_view value);
+    // ISUPPORT CHANMODES, e.g. "beI,k,l,imnpst"
+    void SetChannelModes(std::string_view value);
+
+    // Our own JOIN / PART. AddChannel returns the new id, or -1 when all
+    // kMaxChannels are in use (the channel then simply is not tracked).
+    int AddChannel(std::string_view name);
+    void RemoveChannel(int channel);
+    int FindChannel(std::string_view name) const;
+    int FindChannel(InternId name) const;
+    InternId ChannelId(int channel) const;
+    std::string_view ChannelName(int channel) const;
+
+    void AddMember(int channel, std::string_view nick, uint8_t prefixes);
+    bool RemoveMember(int channel, std::string_view nick);
+    // Mask of channels the nick shares with us, 0 if none
+    uint32_t ChannelsOf(std::string_view nick) const;
+    uint32_t ChannelsOf(InternId user) const {
+        return user < userChannels.size() ? userChannels[user] : 0;
+    }
+    // QUIT: drops the nick from every channel; returns where it was
+    uint32_t RemoveUser(std::string_view nick);
+    // Netsplit: drops many users at once, compacting each channel they
+    // were in a single time. masks[i] receives users[i]'s channels; the
+    // union is returned.
+    uint32_t RemoveUsers(const InternId* users, size_t count, uint32_t* masks);
+    // Netjoin: adds users (without prefixes) with one sort and merge
+    // instead of an insert each. Takes its own references.
+    void AddMembers(int channel, const InternId* users, size_t count);
+    // NICK: returns the channels that saw the change
+    uint32_t RenameUser(std::string_view oldNick, std::string_view newNick);
+
+    // MODE support: bit for a prefix mode letter (o, v...), -1 if it is
+    // not one, and whether another mode letter consumes a parameter
+    int PrefixBitForMode(char mode) const;
+    bool ModeTakesParam(char mode, bool adding) const;
+    void SetMemberPrefix(int channel, std::string_view nick, int bit, bool set);
+
+    // 353 adds to a pending list, unsorted; 366 sorts it once and swaps
+    // it in, replacing whatever the channel held before.
+    void AddNames(int channel, std::string_view names);
+    void EndNames(int channel);
+
+    size_t MemberCount(int channel) const;
+    const Member& MemberAt(int channel, size_t index) const;
+    std::string_view NickOf(const Member& member) const;
+    // Members holding the given PREFIX bit (0 = ops on most networks)
+    size_t CountWithPrefix(int channel, int bit) const;
+    // Highest prefix symbol, or 0
+    char PrefixSymbol(uint8_t prefixes) const;
+
+    // Nicks sharing at least one channel with us
+    size_t UserCount() const { return userCount; }
+    // Member arrays and channel masks; names are in the InternTable
+    size_t MemoryBytes() const;
+
+private:
+    struct Channel {
+        InternId name;
+        std::vector<Member> members;  // sorted by folded nick
+        std::vector<Member> pending;  // NAMES burst in progress
+        bool inNames;
+    };
+
+    InternTable& interns;
+    CaseMapping mapping;
+    std::vector<uint32_t> userChannels;  // indexed by InternId, bit per channel
+    size_t userCount;
+    Channel* channels[kMaxChannels];
+    std::string prefixModes;          // "ov"
+    std::string prefixSymbols;        // "@+"
+    std::string paramModes;           // CHANMODES types A and B: always take a parameter
+    std::string setParamModes;        // type C: only when set
+
+    void SetChannels(InternId user, uint32_t mask);
+    // Index of the member for 'nick' in 'channel', or where it would go
+    size_t LowerBound(const Channel& channel, std::string_view nick) const;
+    Member* FindMember(Channel& channel, std::string_view nick);
+    // Index of 'user' itself, or members.size(); nicks that only collide
+    // under a changed case mapping sort together but are not it
+    size_t IndexOf(const Channel& channel, InternId user, std::string_view nick) const;
+    void Sort(std::vector<Member>& members) const;
+
+    Membership(const Membership&);
+    Membership& operator=(const Membership&);
+};
+
+#endif // MEMBERSHIP_H
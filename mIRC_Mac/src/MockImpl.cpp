@@ -37,6 +37,7 @@ void DragWindow(WindowPtr, Point, Rect*) {}
 long GrowWindow(WindowPtr, Point, Rect*) { return 0; }
 void SizeWindow(WindowPtr, int16_t, int16_t, Boolean) {}
 void InvalRect(const Rect*) {}
+void ClipRect(const Rect*) {}
 void EraseRect(const Rect*) {}
 int16_t FindWindow(Point, WindowPtr*) { return 0; }
 long GetWRefCon(WindowPtr) { return 0; }
@@ -47,6 +48,14 @@ Boolean TrackGoAway(WindowPtr, Point) { return false; }
 Handle GetNewMBar(int16_t) { return NULL; }
 void SetMenuBar(Handle) {}
 void DisposeHandle(Handle) {}
+Handle NewHandle(int32_t size) {
+    Handle h = new Ptr;
+    *h = (Ptr)malloc(size > 0 ? size : 1);
+    return h;
+}
+void SetHandleSize(Handle h, int32_t size) {
+    *h = (Ptr)realloc(*h, size > 0 ? size : 1);
+}
 void AppendResMenu(MenuHandle, uint32_t) {}
 MenuHandle GetMenuHandle(int16_t) { return NULL; }
 
@@ -67,7 +76,7 @@ void SystemTask() {}
 
 // TextEdit Functions
 TEHandle TENew(const Rect*, const Rect*) {
-    TEPtr p = new TERec;
+    TEPtr p = new TERec();
     p->teLength = 0;
     p->hText = new Ptr; // Mock handle
     *(p->hText) = new char[1024]; // buffer
@@ -75,6 +84,8 @@ TEHandle TENew(const Rect*, const Rect*) {
     *h = p;
     return h;
 }
+TEHandle TEStyleNew(const Rect* dest, const Rect* view) { return TENew(dest, view); }
+void TEStyleInsert(const void*, int32_t, StScrpHandle, TEHandle) {}
 void TEDispose(TEHandle) {}
 void TEKey(char, TEHandle) {}
 void TEClick(Point, Boolean, TEHandle) {}
@@ -83,6 +94,7 @@ void TEActivate(TEHandle) {}
 void TEDeactivate(TEHandle) {}
 void TEIdle(TEHandle) {}
 void TEInsert(const void*, int32_t, TEHandle) {}
+void TESetText(const void*, int32_t, TEHandle) {}
 void TESetSelect(long, long, TEHandle) {}
 void TEAutoView(Boolean, TEHandle) {}
 void TEScroll(int16_t, int16_t, TEHandle) {}
@@ -95,6 +107,9 @@ void TECalText(TEHandle) {}
 // QuickDraw Functions
 void MoveTo(int16_t, int16_t) {}
 void LineTo(int16_t, int16_t) {}
+void ScrollRect(const Rect*, int16_t, int16_t, RgnHandle) {}
+RgnHandle NewRgn() { return NULL; }
+void DisposeRgn(RgnHandle) {}
 void DrawString(const unsigned char*) {}
 int16_t StringWidth(const unsigned char*) { return 0; }
 void TextFont(int16_t) {}
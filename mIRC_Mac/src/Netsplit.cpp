@@ -0,0 +1,189 @@
+#include "Netsplit.h"
+#include <algorithm>
+
+static inline bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Dotted host name ending in an alphabetic top-level label
+static bool IsHostName(std::string_view name) {
+    size_t lastDot = std::string_view::npos;
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if (c == '.') {
+            if (i == 0 || name[i - 1] == '.') return false;
+            lastDot = i;
+        } else if (!IsAlpha(c) && !IsDigit(c) && c != '-') {
+            return false;
+        }
+    }
+    if (lastDot == std::string_view::npos || name.size() - lastDot - 1 < 2) return false;
+    for (size_t i = lastDot + 1; i < name.size(); i++) {
+        if (!IsAlpha(name[i])) return false;
+    }
+    return true;
+}
+
+static bool EntryBefore(const NetsplitTracker::Entry& a, const NetsplitTracker::Entry& b) {
+    return a.nick < b.nick || (a.nick == b.nick && a.channel < b.channel);
+}
+
+static bool EntryNickBefore(const NetsplitTracker::Entry& entry, InternId nick) {
+    return entry.nick < nick;
+}
+
+NetsplitTracker::NetsplitTracker(InternTable& interns, Membership& membership)
+    : interns(interns), membership(membership), lastActivity(0) {
+}
+
+NetsplitTracker::~NetsplitTracker() {
+    Clear();
+}
+
+void NetsplitTracker::Clear() {
+    for (size_t i = 0; i < groups.size(); i++) DropGroup(groups[i]);
+    groups.clear();
+    // Queued quits hold no references: the members still do
+    quits.clear();
+    for (size_t i = 0; i < joins.size(); i++) interns.Release(joins[i].nick);
+    joins.clear();
+}
+
+void NetsplitTracker::DropGroup(Group& group) {
+    for (size_t i = 0; i < group.entries.size(); i++) {
+        interns.Release(group.entries[i].nick);
+        interns.Release(group.entries[i].channel);
+    }
+    group.entries.clear();
+}
+
+bool NetsplitTracker::IsSplitReason(std::string_view reason) {
+    size_t space = reason.find(' ');
+    if (space == std::string_view::npos) return false;
+    std::string_view near = reason.substr(0, space);
+    std::string_view far = reason.substr(space + 1);
+    return near != far && IsHostName(near) && IsHostName(far);
+}
+
+bool NetsplitTracker::Accepts(std::string_view servers) const {
+    if (!Pending()) return true;
+    return !quits.empty() && groups.back().servers == servers;
+}
+
+bool NetsplitTracker::AddQuit(std::string_view nick, std::string_view servers, uint32_t now) {
+    InternId user = interns.Find(nick);
+    if (user == kNoIntern || !membership.ChannelsOf(user)) return false;
+
+    if (quits.empty()) {
+        // A new split. Nothing is queued (see Accepts), so older groups
+        // can go without invalidating a PendingJoin.
+        while (!groups.empty() && (groups.size() == kMaxGroups ||
+                                   (uint32_t)(now - groups.front().start) >= kRememberMillis)) {
+            DropGroup(groups.front());
+            groups.pop_front();
+        }
+        groups.push_back(Group());
+        Group& group = groups.back();
+        group.servers.assign(servers.data(), servers.size());
+        group.start = now;
+        group.rejoins = 0;
+    }
+    quits.push_back(user);
+    lastActivity = now;
+    return true;
+}
+
+bool NetsplitTracker::AddJoin(int channel, std::string_view nick, uint32_t now) {
+    InternId user = interns.Find(nick);
+    if (user == kNoIntern) return false;
+    InternId channelId = membership.ChannelId(channel);
+
+    // Newest split first; its entries are sorted once its quits are flushed
+    for (size_t g = groups.size(); g-- > 0;) {
+        Group& group = groups[g];
+        if ((uint32_t)(now - group.start) >= kRememberMillis) break;
+        std::vector<Entry>::iterator it =
+            std::lower_bound(group.entries.begin(), group.entries.end(), user, EntryNickBefore);
+        for (; it != group.entries.end() && it->nick == user; ++it) {
+            if (it->channel != channelId || it->rejoined) continue;
+            it->rejoined = true;
+            group.rejoins++;
+            interns.Retain(user);
+            PendingJoin join = { user, channel, g };
+            joins.push_back(join);
+            lastActivity = now;
+            return true;
+        }
+    }
+    return false;
+}
+
+void NetsplitTracker::Flush(std::vector<NetsplitSummary>& out) {
+    if (!quits.empty()) FlushQuits(out);
+    if (!joins.empty()) FlushJoins(out);
+}
+
+void NetsplitTracker::FlushQuits(std::vector<NetsplitSummary>& out) {
+    Group& group = groups.back();
+    size_t count = quits.size();
+    maskScratch.resize(count);
+
+    // The entries keep the ids alive once the members let go
+    for (size_t i = 0; i < count; i++) interns.Retain(quits[i]);
+    membership.RemoveUsers(&quits[0], count, &maskScratch[0]);
+
+    uint32_t perChannel[Membership::kMaxChannels] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        uint32_t mask = maskScratch[i];
+        for (int c = 0; mask; c++, mask >>= 1) {
+            if (!(mask & 1)) continue;
+            Entry entry = { quits[i], membership.ChannelId(c), false };
+            interns.Retain(entry.nick);
+            interns.Retain(entry.channel);
+            group.entries.push_back(entry);
+            perChannel[c]++;
+        }
+        interns.Release(quits[i]);
+    }
+    std::sort(group.entries.begin(), group.entries.end(), EntryBefore);
+    quits.clear();
+
+    for (int c = 0; c < Membership::kMaxChannels; c++) {
+        if (!perChannel[c]) continue;
+        NetsplitSummary summary = { c, false, perChannel[c], group.servers };
+        out.push_back(summary);
+    }
+}
+
+void NetsplitTracker::FlushJoins(std::vector<NetsplitSummary>& out) {
+    std::sort(joins.begin(), joins.end(), [](const PendingJoin& a, const PendingJoin& b) {
+        return a.channel < b.channel || (a.channel == b.channel && a.group < b.group);
+    });
+
+    // One bulk add per channel, one summary per channel and split
+    size_t start = 0;
+    while (start < joins.size()) {
+        int channel = joins[start].channel;
+        size_t end = start;
+        idScratch.clear();
+        while (end < joins.size() && joins[end].channel == channel) idScratch.push_back(joins[end++].nick);
+        membership.AddMembers(channel, &idScratch[0], idScratch.size());
+
+        for (size_t run = start; run < end;) {
+            size_t group = joins[run].group;
+            size_t next = run;
+            while (next < end && joins[next].group == group) next++;
+            NetsplitSummary summary = { channel, true, (uint32_t)(next - run), groups[group].servers };
+            out.push_back(summary);
+            run = next;
+        }
+        start = end;
+    }
+
+    for (size_t i = 0; i < joins.size(); i++) interns.Release(joins[i].nick);
+    joins.clear();
+}
@@ -0,0 +1,109 @@
+#ifndef NETSPLIT_H
+#define NETSPLIT_H
+
+#include "InternTable.h"
+#include "Membership.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One line's worth of a coalesced split or rejoin, per channel
+struct NetsplitSummary {
+    int channel;               // Membership channel index
+    bool rejoined;             // netjoin rather than netsplit
+    uint32_t count;
+    std::string_view servers;  // "hub.example.net leaf.example.net"; valid until the next AddQuit
+};
+
+// Coalesces the QUIT storm of a netsplit, and the JOINs when the servers
+// relink, into a summary per channel. A QUIT whose reason is two server
+// names is queued instead of reported; so is the JOIN of a nick that left
+// in a remembered split. Flush() then applies the whole queue to the
+// Membership in one pass per channel (rather than a sorted-array erase or
+// insert per user) and reports the counts. Splits are kept for a while
+// afterwards so their nicks can be listed and their rejoins recognised.
+//
+// IRCClient flushes once the burst goes quiet for kQuietMillis and before
+// any message that reads or changes membership, so the lists are never
+// observed half-updated.
+class NetsplitTracker {
+public:
+    static const uint32_t kQuietMillis = 1500;
+    static const uint32_t kRememberMillis = 15 * 60 * 1000;
+    static const size_t kMaxGroups = 4;
+    // Queue length that forces a flush even mid-burst
+    static const size_t kMaxPending = 4096;
+
+    // A nick that left one channel in a split; holds references on both ids
+    struct Entry {
+        InternId nick;
+        InternId channel;
+        bool rejoined;
+    };
+
+    struct Group {
+        std::string servers;
+        uint32_t start;              // ClockMillis() of the first QUIT
+        std::vector<Entry> entries;  // sorted by nick once flushed
+        size_t rejoins;
+    };
+
+    NetsplitTracker(InternTable& interns, Membership& membership);
+    ~NetsplitTracker();
+
+    // Drops everything, queued or remembered (disconnect)
+    void Clear();
+
+    // "hub.example.net leaf.example.net": two different host names
+    static bool IsSplitReason(std::string_view reason);
+
+    // False when work for a different split is queued: flush first
+    bool Accepts(std::string_view servers) const;
+    // Queues a split QUIT; false if the nick shares no channel with us
+    bool AddQuit(std::string_view nick, std::string_view servers, uint32_t now);
+    // Queues a JOIN if the nick left 'channel' in a remembered split
+    bool AddJoin(int channel, std::string_view nick, uint32_t now);
+
+    bool Pending() const { return !quits.empty() || !joins.empty(); }
+    bool HasQuits() const { return !quits.empty(); }
+    bool Due(uint32_t now) const {
+        return Pending() && ((uint32_t)(now - lastActivity) >= kQuietMillis ||
+                             quits.size() + joins.size() >= kMaxPending);
+    }
+
+    // Applies the queue to the membership; appends one summary per
+    // channel and split
+    void Flush(std::vector<NetsplitSummary>& out);
+
+    // Remembered splits, oldest first
+    size_t GroupCount() const { return groups.size(); }
+    const Group& GroupAt(size_t index) const { return groups[index]; }
+
+private:
+    struct PendingJoin {
+        InternId nick;  // holds a reference
+        int channel;
+        size_t group;
+    };
+
+    InternTable& interns;
+    Membership& membership;
+    std::deque<Group> groups;
+    std::vector<InternId> quits;      // all for groups.back()
+    std::vector<PendingJoin> joins;
+    uint32_t lastActivity;
+    std::vector<uint32_t> maskScratch;
+    std::vector<InternId> idScratch;
+
+    void FlushQuits(std::vector<NetsplitSummary>& out);
+    void FlushJoins(std::vector<NetsplitSummary>& out);
+    void DropGroup(Group& group);
+
+    NetsplitTracker(const NetsplitTracker&);
+    NetsplitTracker& operator=(const NetsplitTracker&);
+};
+
+#endif // NETSPLIT_H
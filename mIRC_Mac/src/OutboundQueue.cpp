@@ -0,0 +1,153 @@
+#include "OutboundQueue.h"
+#include <cstring>
+
+// Per-class queue sizes: pastes get the most room, PONG/QUIT very little
+static const size_t kQueueSizes[OutboundQueue::kPriorityCount] = { 1024, 4096, 16384 };
+
+// Record layout in each class queue: enqueue time, line length, line+CRLF
+static const size_t kHeaderSize = sizeof(uint32_t) + sizeof(uint16_t);
+
+// Roughly what solanum/hybrid tolerate from a registered client
+static const OutboundQueue::FloodControl kDefaultFloodControl = { 5, 1000, 0 };
+
+OutboundQueue::OutboundQueue()
+    : queues{ SendBuffer(kQueueSizes[0]), SendBuffer(kQueueSizes[1]), SendBuffer(kQueueSizes[2]) },
+      flood(kDefaultFloodControl), credit(0), lastRefill(0) {
+    memset(stats, 0, sizeof(stats));
+    credit = Capacity();
+}
+
+void OutboundQueue::SetFloodControl(const FloodControl& control) {
+    flood = control;
+    if (flood.millisPerToken == 0) flood.millisPerToken = 1;
+    if (flood.burst == 0) flood.burst = 1;
+    if (credit > Capacity()) credit = Capacity();
+}
+
+int32_t OutboundQueue::CostOf(size_t length) const {
+    unsigned tokens = 1;
+    if (flood.bytesPerToken) tokens += (unsigned)(length / flood.bytesPerToken);
+    return (int32_t)(tokens * flood.millisPerToken);
+}
+
+void OutboundQueue::Refill(uint32_t nowMillis) {
+    uint32_t elapsed = nowMillis - lastRefill;
+    lastRefill = nowMillis;
+    int32_t cap = Capacity();
+    if (elapsed >= (uint32_t)(2 * cap)) {
+        credit = cap; // also avoids overflow after long idle periods
+    } else {
+        credit += (int32_t)elapsed;
+        if (credit > cap) credit = cap;
+    }
+}
+
+bool OutboundQueue::Enqueue(Priority priority, std::initializer_list<std::string_view> pieces, uint32_t nowMillis) {
+    size_t length = 0;
+    for (std::string_view piece : pieces) {
+        size_t cut = piece.find_first_of("\r\n");
+        if (cut != std::string_view::npos) {
+            length += cut;
+            break;
+        }
+        length += piece.size();
+    }
+    if (length > 510) length = 510; // RFC 1459 line limit, CRLF excluded
+
+    SendBuffer& queue = queues[priority];
+    char* dst = queue.Reserve(kHeaderSize + length + 2);
+    if (!dst) {
+        stats[priority].droppedLines++;
+        return false;
+    }
+
+    uint16_t lineLength = (uint16_t)(length + 2);
+    memcpy(dst, &nowMillis, sizeof(nowMillis));
+    memcpy(dst + sizeof(nowMillis), &lineLength, sizeof(lineLength));
+
+    char* text = dst + kHeaderSize;
+    size_t remaining = length;
+    for (std::string_view piece : pieces) {
+        size_t n = (piece.size() < remaining) ? piece.size() : remaining;
+        memcpy(text, piece.data(), n);
+        text += n;
+        remaining -= n;
+        if (remaining == 0) break;
+    }
+    text[0] = '\r';
+    text[1] = '\n';
+    queue.Commit(kHeaderSize + lineLength);
+
+    ClassStats& s = stats[priority];
+    s.depthLines++;
+    s.depthBytes += lineLength;
+    if (s.depthLines > s.maxDepthLines) s.maxDepthLines = s.depthLines;
+    return true;
+}
+
+void OutboundQueue::Pump(SendBuffer& out, uint32_t nowMillis) {
+    Refill(nowMillis);
+
+    for (int p = 0; p < kPriorityCount; p++) {
+        SendBuffer& queue = queues[p];
+        ClassStats& s = stats[p];
+
+        while (!queue.Empty()) {
+            const char* record = queue.Data();
+            uint32_t queuedAt;
+            uint16_t lineLength;
+            memcpy(&queuedAt, record, sizeof(queuedAt));
+            memcpy(&lineLength, record + sizeof(queuedAt), sizeof(lineLength));
+
+            int32_t cost = CostOf(lineLength);
+            if (p != kPriorityUrgent && credit < cost) return; // lower classes wait too
+
+            char* dst = out.Reserve(lineLength);
+            if (!dst) return;
+            memcpy(dst, record + kHeaderSize, lineLength);
+            out.Commit(lineLength);
+            queue.Consume(kHeaderSize + lineLength);
+
+            // Urgent lines still pay, so the bucket reflects what the
+            // server has actually seen
+            credit -= cost;
+            if (credit < -Capacity()) credit = -Capacity();
+
+            uint32_t waited = nowMillis - queuedAt;
+            s.depthLines--;
+            s.depthBytes -= lineLength;
+            s.linesSent++;
+            s.totalWaitMillis += waited;
+            if (waited > s.maxWaitMillis) s.maxWaitMillis = waited;
+        }
+    }
+}
+
+bool OutboundQueue::Empty() const {
+    for (int p = 0; p < kPriorityCount; p++) {
+        if (!queues[p].Empty()) return false;
+    }
+    return true;
+}
+
+uint32_t OutboundQueue::MillisUntilReady(uint32_t nowMillis) const {
+    for (int p = 0; p < kPriorityCount; p++) {
+        if (queues[p].Empty()) continue;
+        if (p == kPriorityUrgent) return 0;
+
+        uint16_t lineLength;
+        memcpy(&lineLength, queues[p].Data() + sizeof(uint32_t), sizeof(lineLength));
+        int32_t level = credit + (int32_t)(nowMillis - lastRefill);
+        int32_t cost = CostOf(lineLength);
+        return (level >= cost) ? 0 : (uint32_t)(cost - level);
+    }
+    return 0;
+}
+
+void OutboundQueue::Clear() {
+    for (int p = 0; p < kPriorityCount; p++) {
+        queues[p].Clear();
+        stats[p].depthLines = 0;
+        stats[p].depthBytes = 0;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include "SendBuffer.h"
+#include <cstdint>
+
+// Priority-aware scheduler in front of the socket send buffer.
+//
+// Each priority class has its own FIFO. Pump() moves lines into the send
+// buffer highest class first, paced by a token bucket so a long paste
+// never trips the server's flood protection, while PONG/QUIT jump the
+// queue and are never held back by the bucket.
+class OutboundQueue {
+public:
+    enum Priority {
+        kPriorityUrgent = 0,  // PONG, QUIT
+        kPriorityInteractive, // typed commands and messages
+        kPriorityBulk,        // pastes and scripted multi-target output
+        kPriorityCount
+    };
+
+    // Token bucket. A line costs one token plus one more for every
+    // bytesPerToken bytes (0 = flat cost); tokens refill one per
+    // millisPerToken up to 'burst'. Mirrors the ircd penalty clock.
+    struct FloodControl {
+        unsigned burst;
+        uint32_t millisPerToken;
+        unsigned bytesPerToken;
+    };
+
+    struct ClassStats {
+        unsigned depthLines;      // currently queued
+        size_t depthBytes;
+        unsigned maxDepthLines;
+        unsigned long linesSent;
+        unsigned long droppedLines; // queue full
+        unsigned long totalWaitMillis;
+        uint32_t maxWaitMillis;
+    };
+
+    OutboundQueue();
+
+    void SetFloodControl(const FloodControl& control);
+    const FloodControl& GetFloodControl() const { return flood; }
+
+    // Queues the concatenated pieces as one line. CR/LF inside the pieces
+    // ends the line there, so user text cannot smuggle extra commands.
+    bool Enqueue(Priority priority, std::initializer_list<std::string_view> pieces, uint32_t nowMillis);
+
+    // Moves every line the bucket allows into 'out'
+    void Pump(SendBuffer& out, uint32_t nowMillis);
+
+    bool Empty() const;
+    // Milliseconds until the bucket will release the next queued line
+    // (0 if something can go now)
+    uint32_t MillisUntilReady(uint32_t nowMillis) const;
+
+    void Clear();
+
+    const ClassStats& GetStats(Priority priority) const { return stats[priority]; }
+
+private:
+    SendBuffer queues[kPriorityCount];
+    ClassStats stats[kPriorityCount];
+    FloodControl flood;
+    int32_t credit;        // bucket level in milliseconds of send time
+    uint32_t lastRefill;
+
+    int32_t Capacity() const { return (int32_t)(flood.burst * flood.millisPerToken); }
+    int32_t CostOf(size_t length) const;
+    void Refill(uint32_t nowMillis);
+};
+
+#endif // OUTBOUND_QUEUE_H
@@ -0,0 +1,65 @@
+#include "PhaseStats.h"
+#include <cstring>
+
+const unsigned kPhaseSampleInterval = 16;
+
+static const char* const kPhaseNames[kPhaseCount] = {
+    "SocketRead",
+    "Framing",
+    "Parse",
+    "Dispatch",
+    "Append",
+    "Redraw",
+    "LogFlush",
+};
+
+static PhaseStats gPhaseStats[kPhaseCount];
+static unsigned gSampleCounters[kPhaseCount];
+
+const char* PhaseName(int phase) {
+    return (phase >= 0 && phase < kPhaseCount) ? kPhaseNames[phase] : "?";
+}
+
+const PhaseStats& GetPhaseStats(int phase) {
+    return gPhaseStats[phase];
+}
+
+void PhaseRecord(int phase, uint32_t micros) {
+    PhaseStats& s = gPhaseStats[phase];
+    if (s.samples == 0 || micros < s.minMicros) s.minMicros = micros;
+    if (micros > s.maxMicros) s.maxMicros = micros;
+    s.samples++;
+    s.totalMicros += micros;
+
+    int bucket = 0;
+    while (bucket < kPhaseBucketCount - 1 && (micros >> bucket) != 0) bucket++;
+    s.buckets[bucket]++;
+}
+
+uint32_t PhasePercentile(int phase, unsigned percent) {
+    const PhaseStats& s = gPhaseStats[phase];
+    if (s.samples == 0) return 0;
+
+    unsigned long long rank = ((unsigned long long)s.samples * percent + 99) / 100;
+    if (rank == 0) rank = 1;
+    unsigned long long seen = 0;
+    for (int b = 0; b < kPhaseBucketCount; b++) {
+        seen += s.buckets[b];
+        if (seen >= rank) {
+            uint32_t bound = (b == 0) ? 0 : (1u << b) - 1;
+            return bound < s.maxMicros ? bound : s.maxMicros;
+        }
+    }
+    return s.maxMicros;
+}
+
+void ResetPhaseStats() {
+    memset(gPhaseStats, 0, sizeof(gPhaseStats));
+    memset(gSampleCounters, 0, sizeof(gSampleCounters));
+}
+
+bool PhaseSample(int phase) {
+    if (++gSampleCounters[phase] < kPhaseSampleInterval) return false;
+    gSampleCounters[phase] = 0;
+    return true;
+}
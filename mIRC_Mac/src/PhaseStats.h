@@ -0,0 +1,81 @@
+#ifndef PHASE_STATS_H
+#define PHASE_STATS_H
+
+#include "Clock.h"
+#include <cstdint>
+
+// Always-on timing of the main loop phases, shown by /stats. Each phase
+// keeps a count, total, min/max and a log2 histogram of durations in
+// microseconds, so percentiles come out to within a factor of two.
+//
+// Reading the clock costs a trap on the Mac (and is not free under Linux
+// either), so the per-line phases (framing, parse, dispatch, append) are
+// only timed on one line in kPhaseSampleInterval. Socket reads, redraws
+// and log flushes are timed every time.
+
+enum Phase {
+    kPhaseSocketRead,
+    kPhaseFraming,    // pulling one line out of the receive buffer
+    kPhaseParse,
+    kPhaseDispatch,   // protocol handlers, up to the events being ready
+    kPhaseAppend,
+    kPhaseRedraw,
+    kPhaseLogFlush,   // LogWriter writing buffered lines to disk
+    kPhaseCount
+};
+
+static const int kPhaseBucketCount = 24; // bucket b holds durations < 2^b us
+
+struct PhaseStats {
+    unsigned long samples;
+    unsigned long long totalMicros;
+    uint32_t minMicros;
+    uint32_t maxMicros;
+    uint32_t buckets[kPhaseBucketCount];
+};
+
+extern const unsigned kPhaseSampleInterval;
+
+const char* PhaseName(int phase);
+const PhaseStats& GetPhaseStats(int phase);
+void PhaseRecord(int phase, uint32_t micros);
+// Upper bound of the bucket holding the given percentile, 0 if no samples
+uint32_t PhasePercentile(int phase, unsigned percent);
+void ResetPhaseStats();
+
+// True on the lines that should be timed for this phase
+bool PhaseSample(int phase);
+
+// Times consecutive phases with one clock read per boundary
+class PhaseLap {
+public:
+    explicit PhaseLap(bool enabled) : enabled(enabled), last(enabled ? ClockMicros() : 0) {}
+
+    bool Enabled() const { return enabled; }
+
+    void Lap(Phase phase) {
+        if (!enabled) return;
+        uint32_t now = ClockMicros();
+        PhaseRecord(phase, now - last);
+        last = now;
+    }
+
+private:
+    bool enabled;
+    uint32_t last;
+};
+
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase phase, bool enabled = true) : phase(phase), lap(enabled) {}
+    ~PhaseScope() { lap.Lap(phase); }
+
+private:
+    Phase phase;
+    PhaseLap lap;
+
+    PhaseScope(const PhaseScope&);
+    PhaseScope& operator=(const PhaseScope&);
+};
+
+#endif // PHASE_STATS_H
@@ -0,0 +1,218 @@
+#include "Resolver.h"
+
+#include <cstring>
+
+#if defined(__GLIBC__)
+    #define RESOLVER_ASYNC 1
+#elif !defined(LOCAL_TESTING) && !defined(__unix__)
+    #define RESOLVER_DNR 1
+#endif
+
+#ifdef RESOLVER_DNR
+    #include <MacTCP.h>
+    #include <AddressXlation.h>
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <netdb.h>
+#endif
+
+#if defined(RESOLVER_ASYNC)
+
+struct HostResolver::Request {
+    struct gaicb cb;
+    struct addrinfo hints;
+    std::string name;  // the worker reads it until the lookup ends
+};
+
+#elif defined(RESOLVER_DNR)
+
+// MacTCP's resolver answers through a completion routine, called at
+// interrupt time; it only sets 'done'. The resolver cannot be told to
+// forget a query, so a cancelled one is kept until its routine has run.
+struct HostResolver::Request {
+    struct hostInfo info;
+    volatile bool done;
+    std::string name;  // StrToAddr takes a C string
+};
+
+// 'userData' is the request's 'done' flag
+static pascal void LookupDone(struct hostInfo* info, char* userData) {
+    (void)info;
+    *(volatile bool*)userData = true;
+}
+
+// Opened on first use and left open: closing it with a query outstanding
+// would pull the code out from under the completion routine
+static bool gResolverOpen = false;
+static ResultUPP gLookupDoneUPP = nullptr;
+
+#else
+
+struct HostResolver::Request {
+};
+
+#endif
+
+HostResolver::HostResolver() : request(nullptr), result(0), status(kIdle) {
+}
+
+HostResolver::~HostResolver() {
+    Cancel();
+    // Lookups still running at exit are left to the process teardown
+    ReapAbandoned();
+}
+
+void HostResolver::ReapAbandoned() {
+#if defined(RESOLVER_ASYNC) || defined(RESOLVER_DNR)
+    size_t kept = 0;
+    for (size_t i = 0; i < abandoned.size(); i++) {
+        Request* old = abandoned[i];
+#ifdef RESOLVER_ASYNC
+        if (gai_error(&old->cb) == EAI_INPROGRESS) {
+            abandoned[kept++] = old;
+            continue;
+        }
+        if (old->cb.ar_result) freeaddrinfo(old->cb.ar_result);
+#else
+        if (!old->done) {
+            abandoned[kept++] = old;
+            continue;
+        }
+#endif
+        delete old;
+    }
+    abandoned.resize(kept);
+#endif
+}
+
+void HostResolver::Start(const std::string& host) {
+    Cancel();
+    ReapAbandoned();
+    hostName = host;
+
+#ifndef RESOLVER_DNR
+    struct in_addr numeric;
+    if (inet_aton(hostName.c_str(), &numeric)) {
+        result = numeric.s_addr;
+        status = kDone;
+        return;
+    }
+#endif
+
+    status = kPending;
+#if defined(RESOLVER_ASYNC)
+    request = new Request();
+    memset(&request->cb, 0, sizeof(request->cb));
+    memset(&request->hints, 0, sizeof(request->hints));
+    request->hints.ai_family = AF_INET;
+    request->hints.ai_socktype = SOCK_STREAM;
+    request->name = hostName;
+    request->cb.ar_name = request->name.c_str();
+    request->cb.ar_request = &request->hints;
+
+    struct gaicb* list[1] = { &request->cb };
+    if (getaddrinfo_a(GAI_NOWAIT, list, 1, nullptr) != 0) {
+        delete request;
+        request = nullptr;
+        status = kFailed;
+    }
+#elif defined(RESOLVER_DNR)
+    if (!gResolverOpen) {
+        if (OpenResolver(nullptr) != noErr) {
+            status = kFailed;
+            return;
+        }
+        gLookupDoneUPP = NewResultUPP(LookupDone);
+        gResolverOpen = true;
+    }
+
+    // Dotted quads and cached names come straight back; anything else
+    // goes out to the name server and finishes in LookupDone
+    request = new Request();
+    memset(&request->info, 0, sizeof(request->info));
+    request->done = false;
+    request->name = hostName;
+    OSErr err = StrToAddr(&request->name[0], &request->info, gLookupDoneUPP, (char*)&request->done);
+    if (err == cacheFault) return;
+    if (err == noErr && request->info.addr[0] != 0) {
+        result = (uint32_t)request->info.addr[0];
+        status = kDone;
+    } else {
+        status = kFailed;
+    }
+    delete request;
+    request = nullptr;
+#endif
+}
+
+HostResolver::Status HostResolver::Poll(uint32_t& address) {
+    if (!abandoned.empty()) ReapAbandoned();
+    if (status != kPending) {
+        address = result;
+        return status;
+    }
+
+#if defined(RESOLVER_ASYNC)
+    int err = gai_error(&request->cb);
+    if (err == EAI_INPROGRESS) return kPending;
+
+    status = kFailed;
+    if (err == 0 && request->cb.ar_result) {
+        const struct sockaddr_in* sin = (const struct sockaddr_in*)request->cb.ar_result->ai_addr;
+        result = sin->sin_addr.s_addr;
+        status = kDone;
+    }
+    if (request->cb.ar_result) freeaddrinfo(request->cb.ar_result);
+    delete request;
+    request = nullptr;
+#elif defined(RESOLVER_DNR)
+    if (!request->done) return kPending;
+
+    // MacTCP addresses are already in network (big-endian) order
+    status = kFailed;
+    if (request->info.rtnCode == noErr && request->info.addr[0] != 0) {
+        result = (uint32_t)request->info.addr[0];
+        status = kDone;
+    }
+    delete request;
+    request = nullptr;
+#else
+    // Host builds without glibc only: blocks for the lookup
+    struct hostent* server = gethostbyname(hostName.c_str());
+    status = kFailed;
+    if (server && server->h_length == sizeof(result)) {
+        memcpy(&result, server->h_addr, sizeof(result));
+        status = kDone;
+    }
+#endif
+
+    address = result;
+    return status;
+}
+
+void HostResolver::Cancel() {
+#if defined(RESOLVER_ASYNC)
+    if (request) {
+        // A lookup already running cannot be freed while the worker may
+        // still write into it. Waiting could take as long as the lookup
+        // that just timed out, so park it and free it later instead.
+        if (gai_cancel(&request->cb) == EAI_NOTCANCELED) {
+            abandoned.push_back(request);
+        } else {
+            if (request->cb.ar_result) freeaddrinfo(request->cb.ar_result);
+            delete request;
+        }
+        request = nullptr;
+    }
+#elif defined(RESOLVER_DNR)
+    if (request) {
+        // LookupDone will still write into it
+        if (request->done) delete request;
+        else abandoned.push_back(request);
+        request = nullptr;
+    }
+#endif
+    status = kIdle;
+}
@@ -0,0 +1,48 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Polled host name lookup for the connect state machine.
+//
+// Dotted-quad addresses resolve immediately. Otherwise Poll() never
+// blocks: on the Mac the lookup goes through MacTCP's StrToAddr with a
+// completion routine, on glibc through getaddrinfo_a(). Only host builds
+// on other C libraries fall back to gethostbyname() inside the first
+// Poll().
+class HostResolver {
+public:
+    enum Status {
+        kIdle,
+        kPending,
+        kDone,
+        kFailed
+    };
+
+    HostResolver();
+    ~HostResolver();
+
+    void Start(const std::string& host);
+    // On kDone, 'address' holds the IPv4 address in network byte order
+    Status Poll(uint32_t& address);
+    void Cancel();
+
+private:
+    struct Request;
+    Request* request;
+    std::string hostName;
+    uint32_t result;
+    Status status;
+    // Cancelled lookups the system resolver was still working on; freed
+    // by a later Start() or Poll() once it lets go of them
+    std::vector<Request*> abandoned;
+
+    void ReapAbandoned();
+
+    HostResolver(const HostResolver&);
+    HostResolver& operator=(const HostResolver&);
+};
+
+#endif // RESOLVER_H
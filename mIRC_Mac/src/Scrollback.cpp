@@ -0,0 +1,173 @@
+#include "Scrollback.h"
+#include <cstring>
+
+void TrigramAdd(uint8_t* filter, const char* text, size_t length) {
+    if (length < 3) return;
+    uint8_t a = (uint8_t)IRCFoldChar(text[0], CaseMapping::Ascii);
+    uint8_t b = (uint8_t)IRCFoldChar(text[1], CaseMapping::Ascii);
+    for (size_t i = 2; i < length; i++) {
+        uint8_t c = (uint8_t)IRCFoldChar(text[i], CaseMapping::Ascii);
+        unsigned bit = TrigramBit(a, b, c);
+        filter[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+        a = b;
+        b = c;
+    }
+}
+
+// ScrollbackPool
+
+ScrollbackPool::ScrollbackPool(size_t globalCapBytes)
+    : oldest(nullptr), newest(nullptr), freeList(nullptr), liveChunks(0),
+      maxChunks(globalCapBytes / sizeof(ScrollbackChunk)), evictions(0) {
+    if (maxChunks < 2) maxChunks = 2;
+}
+
+ScrollbackPool::~ScrollbackPool() {
+    // Windows release their chunks before the pool goes away
+    while (freeList) {
+        ScrollbackChunk* next = freeList->poolNext;
+        delete freeList;
+        freeList = next;
+    }
+}
+
+void ScrollbackPool::Unlink(ScrollbackChunk* chunk) {
+    if (chunk->poolPrev) chunk->poolPrev->poolNext = chunk->poolNext;
+    else oldest = chunk->poolNext;
+    if (chunk->poolNext) chunk->poolNext->poolPrev = chunk->poolPrev;
+    else newest = chunk->poolPrev;
+}
+
+ScrollbackChunk* ScrollbackPool::Allocate(Scrollback* owner) {
+    // Allocation order is per-window order too, so the globally oldest
+    // chunk is always the front of its owner's list.
+    if (liveChunks >= maxChunks && oldest) {
+        evictions++;
+        oldest->owner->DropOldest();
+    }
+
+    ScrollbackChunk* chunk = freeList;
+    if (chunk) {
+        freeList = chunk->poolNext;
+    } else {
+        chunk = new ScrollbackChunk;
+    }
+
+    chunk->owner = owner;
+    chunk->firstLine = 0;
+    chunk->lineCount = 0;
+    chunk->offsets[0] = 0;
+    memset(chunk->trigrams, 0, sizeof(chunk->trigrams));
+    chunk->poolPrev = newest;
+    chunk->poolNext = nullptr;
+    if (newest) newest->poolNext = chunk;
+    else oldest = chunk;
+    newest = chunk;
+    liveChunks++;
+    return chunk;
+}
+
+void ScrollbackPool::Release(ScrollbackChunk* chunk) {
+    Unlink(chunk);
+    liveChunks--;
+    chunk->owner = nullptr;
+    chunk->poolNext = freeList;
+    freeList = chunk;
+}
+
+// Scrollback
+
+Scrollback::Scrollback(ScrollbackPool& pool, size_t capBytes)
+    : pool(pool), capBytes(capBytes), nextLine(0) {
+}
+
+Scrollback::~Scrollback() {
+    while (!chunks.empty()) DropOldest();
+}
+
+void Scrollback::DropOldest() {
+    if (chunks.empty()) return;
+    ScrollbackChunk* chunk = chunks.front();
+    chunks.pop_front();
+    pool.Release(chunk);
+}
+
+void Scrollback::Append(const char* text, size_t length) {
+    Append({ std::string_view(text, length) });
+}
+
+void Scrollback::Append(std::initializer_list<std::string_view> pieces) {
+    // Assembled outside the chunk: only once the codes are gone is it
+    // known how much room the line takes
+    char* line = pool.LineScratch();
+    size_t length = 0;
+    for (std::string_view piece : pieces) {
+        size_t n = piece.size();
+        if (n > ScrollbackChunk::kTextSize - length) n = ScrollbackChunk::kTextSize - length;
+        memcpy(line + length, piece.data(), n);
+        length += n;
+    }
+
+    StyleRun runs[kMaxStyleRuns];
+    size_t runCount;
+    length = DecodeIRCFormatting(line, length, runs, kMaxStyleRuns, runCount);
+    size_t runBytes = runCount * sizeof(StyleRun);
+    if (length + runBytes > ScrollbackChunk::kTextSize) {
+        runCount = (ScrollbackChunk::kTextSize - length) / sizeof(StyleRun);
+        runBytes = runCount * sizeof(StyleRun);
+    }
+    size_t slot = length + runBytes;
+
+    ScrollbackChunk* chunk = chunks.empty() ? nullptr : chunks.back();
+    if (!chunk || chunk->lineCount == ScrollbackChunk::kMaxLines ||
+        chunk->Used() + slot > ScrollbackChunk::kTextSize) {
+        chunk = pool.Allocate(this);
+        chunk->firstLine = nextLine;
+        chunks.push_back(chunk);
+
+        // Per-window cap: whole chunks go, oldest first
+        while (chunks.size() > 1 && Bytes() > capBytes) DropOldest();
+    }
+
+    size_t start = chunk->Used();
+    memcpy(chunk->text + start, line, length);
+    memcpy(chunk->text + start + length, runs, runBytes);
+    TrigramAdd(chunk->trigrams, chunk->text + start, length);
+    chunk->runCounts[chunk->lineCount] = (uint8_t)runCount;
+    chunk->lineCount++;
+    chunk->offsets[chunk->lineCount] = (uint16_t)(start + slot);
+    nextLine++;
+}
+
+const ScrollbackChunk* Scrollback::FindChunk(uint32_t line) const {
+    if (line < FirstLine() || line >= nextLine) return nullptr;
+
+    // Binary search for the chunk holding 'line'
+    size_t lo = 0, hi = chunks.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (chunks[mid]->firstLine <= line) lo = mid;
+        else hi = mid;
+    }
+    return chunks[lo];
+}
+
+bool Scrollback::GetLine(uint32_t line, const char*& text, size_t& length) const {
+    const StyleRun* runs;
+    size_t runCount;
+    return GetLine(line, text, length, runs, runCount);
+}
+
+bool Scrollback::GetLine(uint32_t line, const char*& text, size_t& length, const StyleRun*& runs,
+                         size_t& runCount) const {
+    const ScrollbackChunk* chunk = FindChunk(line);
+    if (!chunk) return false;
+
+    uint32_t index = line - chunk->firstLine;
+    size_t textEnd = chunk->TextEnd(index);
+    text = chunk->text + chunk->offsets[index];
+    length = textEnd - chunk->offsets[index];
+    runs = (const StyleRun*)(chunk->text + textEnd);
+    runCount = chunk->runCounts[index];
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include "CaseMap.h"
+#include "IRCFormat.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <string_view>
+
+class Scrollback;
+
+// Each chunk carries a filter of the (ASCII-folded) trigrams in its text,
+// set as lines are appended. /search skips any chunk that lacks one of
+// the pattern's trigrams without looking at its text.
+const int kTrigramFilterShift = 11;
+const size_t kTrigramFilterBits = (size_t)1 << kTrigramFilterShift;
+const size_t kTrigramFilterBytes = kTrigramFilterBits / 8;
+
+// Filter bit for three already folded bytes
+inline unsigned TrigramBit(uint8_t a, uint8_t b, uint8_t c) {
+    uint32_t h = ((uint32_t)a << 16 | (uint32_t)b << 8 | c) * 0x9E3779B1u;
+    return h >> (32 - kTrigramFilterShift);
+}
+
+// Adds every trigram of 'text', folded, to 'filter'
+void TrigramAdd(uint8_t* filter, const char* text, size_t length);
+
+// Fixed-size block of packed lines. offsets[i] is where line i starts in
+// text[]; offsets[lineCount] is the end of the last line. A line is its
+// plain text followed by runCounts[i] StyleRuns.
+struct ScrollbackChunk {
+    static const int kMaxLines = 128;
+    static const size_t kTextSize = 3584;
+
+    ScrollbackChunk* poolPrev;  // allocation order across all windows
+    ScrollbackChunk* poolNext;
+    Scrollback* owner;
+    uint32_t firstLine;         // absolute number of line 0
+    uint16_t lineCount;
+    uint16_t offsets[kMaxLines + 1];
+    uint8_t runCounts[kMaxLines];
+    uint8_t trigrams[kTrigramFilterBytes];
+    char text[kTextSize];
+
+    size_t Used() const { return offsets[lineCount]; }
+    size_t TextEnd(size_t line) const { return offsets[line + 1] - runCounts[line] * sizeof(StyleRun); }
+};
+
+// Owns every chunk of every window and enforces the global byte cap.
+// Chunks are recycled through a free list, so a long session stops
+// touching the Memory Manager once it reaches steady state.
+class ScrollbackPool {
+public:
+    explicit ScrollbackPool(size_t globalCapBytes);
+    ~ScrollbackPool();
+
+    // Returns a chunk for 'owner', evicting the oldest chunk of any window
+    // first if the global cap would be exceeded.
+    ScrollbackChunk* Allocate(Scrollback* owner);
+    void Release(ScrollbackChunk* chunk);
+
+    size_t LiveBytes() const { return liveChunks * sizeof(ScrollbackChunk); }
+    size_t CapBytes() const { return maxChunks * sizeof(ScrollbackChunk); }
+    size_t IndexBytes() const { return liveChunks * kTrigramFilterBytes; }
+    // Where Scrollback::Append assembles and decodes a line
+    char* LineScratch() { return lineScratch; }
+    unsigned long Evictions() const { return evictions; }
+
+private:
+    ScrollbackChunk* oldest;  // head of the allocation-order list
+    ScrollbackChunk* newest;
+    ScrollbackChunk* freeList;
+    size_t liveChunks;
+    size_t maxChunks;
+    unsigned long evictions;
+    char lineScratch[ScrollbackChunk::kTextSize];
+
+    void Unlink(ScrollbackChunk* chunk);
+
+    ScrollbackPool(const ScrollbackPool&);
+    ScrollbackPool& operator=(const ScrollbackPool&);
+};
+
+// Per-window history. Lines are numbered from 0 for the life of the
+// window; the oldest ones disappear as caps are hit, so FirstLine() rises.
+// Append is O(1) regardless of how much history is held.
+class Scrollback {
+public:
+    Scrollback(ScrollbackPool& pool, size_t capBytes);
+    ~Scrollback();
+
+    void Append(const char* text, size_t length);
+    // Concatenates the pieces into one line and decodes its mIRC
+    // formatting; the plain text and style runs are what get stored
+    void Append(std::initializer_list<std::string_view> pieces);
+
+    uint32_t FirstLine() const { return chunks.empty() ? nextLine : chunks.front()->firstLine; }
+    uint32_t EndLine() const { return nextLine; }
+    size_t LineCount() const { return EndLine() - FirstLine(); }
+    size_t Bytes() const { return chunks.size() * sizeof(ScrollbackChunk); }
+
+    // False if the line has been evicted or does not exist yet. 'text' is
+    // the plain text, formatting already stripped.
+    bool GetLine(uint32_t line, const char*& text, size_t& length) const;
+    bool GetLine(uint32_t line, const char*& text, size_t& length, const StyleRun*& runs, size_t& runCount) const;
+    // The chunk holding 'line', null if evicted or not there yet
+    const ScrollbackChunk* FindChunk(uint32_t line) const;
+
+    // Called by the pool when it reclaims our oldest chunk
+    void DropOldest();
+
+private:
+    ScrollbackPool& pool;
+    std::deque<ScrollbackChunk*> chunks; // oldest first
+    size_t capBytes;
+    uint32_t nextLine;
+
+    Scrollback(const Scrollback&);
+    Scrollback& operator=(const Scrollback&);
+};
+
+#endif // SCROLLBACK_H
@@ -0,0 +1,257 @@
+#include "Search.h"
+#include "Clock.h"
+#include <cstring>
+
+// Below this Horspool's shifts are too short to pay; look for the first
+// byte with memchr instead
+static const size_t kShortPattern = 4;
+
+// Lines per slice of on-disk history between budget checks
+static const int kLogLinesPerCheck = 64;
+
+static const unsigned char* FoldTable() {
+    static unsigned char table[256];
+    static bool ready = false;
+    if (!ready) {
+        for (int c = 0; c < 256; c++) table[c] = (unsigned char)IRCFoldChar((char)c, CaseMapping::Ascii);
+        ready = true;
+    }
+    return table;
+}
+
+// SearchPattern
+
+SearchPattern::SearchPattern() {
+    memset(shift, 1, sizeof(shift));
+}
+
+void SearchPattern::Compile(std::string_view text) {
+    const unsigned char* fold = FoldTable();
+    size_t length = (text.size() < kMaxLength) ? text.size() : kMaxLength;
+    folded.resize(length);
+    for (size_t i = 0; i < length; i++) folded[i] = (char)fold[(unsigned char)text[i]];
+
+    // Horspool: how far the last byte under the window lets us move
+    memset(shift, (int)(length ? length : 1), sizeof(shift));
+    for (size_t i = 0; i + 1 < length; i++) shift[(unsigned char)folded[i]] = (uint8_t)(length - 1 - i);
+
+    trigrams.clear();
+    for (size_t i = 2; i < length; i++) {
+        uint16_t bit = (uint16_t)TrigramBit((uint8_t)folded[i - 2], (uint8_t)folded[i - 1], (uint8_t)folded[i]);
+        bool seen = false;
+        for (size_t j = 0; j < trigrams.size() && !seen; j++) seen = (trigrams[j] == bit);
+        if (!seen) trigrams.push_back(bit);
+    }
+}
+
+const char* SearchPattern::Find(const char* text, size_t length) const {
+    size_t m = folded.size();
+    if (m == 0) return text;
+    if (length < m) return nullptr;
+
+    const unsigned char* fold = FoldTable();
+    const unsigned char* pattern = (const unsigned char*)folded.data();
+    const unsigned char* bytes = (const unsigned char*)text;
+
+    if (m < kShortPattern) {
+        // Next place either case of the first byte occurs, kept for each
+        unsigned char lower = pattern[0];
+        unsigned char upper = (lower >= 'a' && lower <= 'z') ? (unsigned char)(lower - 32) : lower;
+        const unsigned char* end = bytes + (length - m + 1);
+        const unsigned char* nextLower = (const unsigned char*)memchr(bytes, lower, end - bytes);
+        const unsigned char* nextUpper = nullptr;
+        if (upper != lower) nextUpper = (const unsigned char*)memchr(bytes, upper, end - bytes);
+        for (;;) {
+            const unsigned char* at = nextLower;
+            if (!at || (nextUpper && nextUpper < at)) at = nextUpper;
+            if (!at) return nullptr;
+
+            size_t i = 1;
+            while (i < m && fold[at[i]] == pattern[i]) i++;
+            if (i == m) return (const char*)at;
+            if (at == nextLower) nextLower = (const unsigned char*)memchr(at + 1, lower, end - at - 1);
+            else nextUpper = (const unsigned char*)memchr(at + 1, upper, end - at - 1);
+        }
+    }
+
+    unsigned char last = pattern[m - 1];
+    size_t pos = 0;
+    while (pos + m <= length) {
+        unsigned char c = fold[bytes[pos + m - 1]];
+        if (c == last) {
+            size_t i = 0;
+            while (i + 1 < m && fold[bytes[pos + i]] == pattern[i]) i++;
+            if (i + 1 == m) return text + pos;
+        }
+        pos += shift[c];
+    }
+    return nullptr;
+}
+
+bool SearchPattern::MayMatch(const uint8_t* filter) const {
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        unsigned bit = trigrams[i];
+        if (!(filter[bit >> 3] & (1 << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+// SearchJob
+
+SearchJob::SearchJob() : useIndex(true), running(false), current(0), inLog(false) {
+    memset(&stats, 0, sizeof(stats));
+    logPos = logEnd = history.Begin();
+}
+
+void SearchJob::Start(std::string_view query, bool indexed) {
+    text.assign(query.data(), query.size());
+    pattern.Compile(query);
+    useIndex = indexed;
+    running = !query.empty();
+    sources.clear();
+    current = 0;
+    inLog = false;
+    history.Close();
+    memset(&stats, 0, sizeof(stats));
+}
+
+int SearchJob::AddSource(Scrollback* scrollback, std::string_view logDirectory, std::string_view logName) {
+    Source source;
+    source.scrollback = scrollback;
+    source.logDirectory.assign(logDirectory.data(), logDirectory.size());
+    source.logName.assign(logName.data(), logName.size());
+    source.nextLine = scrollback->FirstLine();
+    source.endLine = scrollback->EndLine();
+    source.hasLog = false;
+    source.logEnd = history.Begin();
+    source.logSkip = 0;
+
+    // The log ends with the lines the scrollback holds; only search what
+    // came before them there. Finding that place means reading backwards
+    // through the log, so it is left to Step(); only the end is fixed now,
+    // before anything else gets logged.
+    HistoryReader reader;
+    if (!logName.empty() && reader.Open(source.logDirectory, logName) && reader.SegmentCount() > 0) {
+        source.hasLog = true;
+        source.logEnd = reader.End();
+        source.logSkip = source.endLine - source.nextLine;
+    }
+
+    sources.push_back(source);
+    return (int)sources.size() - 1;
+}
+
+void SearchJob::RemoveSource(Scrollback* scrollback) {
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (sources[i].scrollback == scrollback) sources[i].scrollback = nullptr;
+    }
+}
+
+void SearchJob::AddHit(std::vector<SearchHit>& hits, bool fromLog, const char* line, size_t length) {
+    SearchHit hit;
+    hit.source = (int)current;
+    hit.fromLog = fromLog;
+    hit.text.assign(line, length);
+    hits.push_back(hit);
+    stats.matches++;
+}
+
+// One chunk of the current source's scrollback; false when there is no
+// more of it
+bool SearchJob::ScanChunk(Source& source, std::vector<SearchHit>& hits) {
+    Scrollback* sb = source.scrollback;
+    if (!sb) return false;
+    if (source.nextLine < sb->FirstLine()) source.nextLine = sb->FirstLine();  // evicted meanwhile
+    if (source.nextLine >= source.endLine) return false;
+    const ScrollbackChunk* chunk = sb->FindChunk(source.nextLine);
+    if (!chunk) return false;
+
+    uint32_t stop = chunk->firstLine + chunk->lineCount;
+    if (stop > source.endLine) stop = source.endLine;
+    uint32_t index = source.nextLine - chunk->firstLine;
+    uint32_t last = stop - chunk->firstLine;
+    size_t at = chunk->offsets[index];
+    size_t end = chunk->offsets[last];
+    source.nextLine = stop;
+
+    if (useIndex && !pattern.MayMatch(chunk->trigrams)) {
+        stats.chunksSkipped++;
+        stats.bytesSkipped += end - at;
+        return true;
+    }
+    stats.chunksScanned++;
+    stats.bytesScanned += end - at;
+    stats.linesScanned += last - index;
+
+    // The chunk's lines are packed back to back, so scan them as one run
+    // and map each match back to its line
+    while (at < end && stats.matches < kMaxHits) {
+        const char* match = pattern.Find(chunk->text + at, end - at);
+        if (!match) break;
+        size_t offset = (size_t)(match - chunk->text);
+        while (chunk->offsets[index + 1] <= offset) index++;
+
+        // Style runs sit between lines and are never a match
+        size_t textEnd = chunk->TextEnd(index);
+        if (offset + pattern.Length() <= textEnd) {
+            AddHit(hits, false, chunk->text + chunk->offsets[index], textEnd - chunk->offsets[index]);
+            at = chunk->offsets[index + 1];  // one hit per line
+        } else {
+            at = offset + 1;  // ran on into the next line, or its runs
+        }
+    }
+    return true;
+}
+
+void SearchJob::NextSource() {
+    current++;
+    inLog = false;
+    history.Close();
+}
+
+bool SearchJob::Step(uint32_t budgetMicros, std::vector<SearchHit>& hits) {
+    if (!running) return false;
+
+    uint32_t start = ClockMicros();
+    while (current < sources.size() && stats.matches < kMaxHits) {
+        Source& source = sources[current];
+        if (!inLog) {
+            if (!ScanChunk(source, hits)) {
+                inLog = true;
+                if (source.hasLog && history.Open(source.logDirectory, source.logName)) {
+                    logPos = history.Begin();
+                } else {
+                    NextSource();
+                }
+            }
+        } else if (source.logSkip) {
+            // Back over the lines the scrollback already had
+            std::string_view line;
+            for (int n = 0; n < kLogLinesPerCheck && source.logSkip; n++, source.logSkip--) {
+                if (!history.PrevLine(source.logEnd, line)) {
+                    source.logSkip = 0;
+                    break;
+                }
+            }
+        } else {
+            std::string_view line;
+            int n = 0;
+            for (; n < kLogLinesPerCheck && stats.matches < kMaxHits; n++) {
+                if (!history.Settle(logPos) || !(logPos < source.logEnd)) break;
+                history.NextLine(logPos, line);
+                stats.linesScanned++;
+                stats.bytesScanned += line.size() + 1;
+                if (pattern.Find(line.data(), line.size())) AddHit(hits, true, line.data(), line.size());
+            }
+            if (n < kLogLinesPerCheck && stats.matches < kMaxHits) NextSource();
+        }
+        if ((uint32_t)(ClockMicros() - start) >= budgetMicros) break;
+    }
+
+    if (current >= sources.size() || stats.matches >= kMaxHits) {
+        running = false;
+        history.Close();
+    }
+    stats.micros += ClockMicros() - start;
+    return running;
+}
@@ -0,0 +1,108 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "History.h"
+#include "Scrollback.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Case-insensitive substring matcher: Horspool over folded bytes, so long
+// patterns skip most of the text without comparing it.
+class SearchPattern {
+public:
+    static const size_t kMaxLength = 255;
+
+    SearchPattern();
+    void Compile(std::string_view text);
+
+    size_t Length() const { return folded.size(); }
+    // Start of the first match in [text, text + length), null if none
+    const char* Find(const char* text, size_t length) const;
+    // False if text whose filter this is cannot contain a match
+    bool MayMatch(const uint8_t* filter) const;
+
+private:
+    std::string folded;
+    uint8_t shift[256];             // by folded byte
+    std::vector<uint16_t> trigrams; // filter bits the text must have
+};
+
+struct SearchHit {
+    int source;
+    bool fromLog;
+    std::string text;
+};
+
+struct SearchStats {
+    unsigned long matches;
+    unsigned long linesScanned;
+    unsigned long bytesScanned;
+    unsigned long chunksScanned;
+    unsigned long chunksSkipped;  // ruled out by their trigram filter
+    unsigned long bytesSkipped;
+    uint32_t micros;              // spent inside Step()
+};
+
+// One /search in progress. Sources are scanned in turn, each one's
+// scrollback first and then its older on-disk history (up to where the
+// scrollback begins), in slices of at most 'budgetMicros' per Step() so
+// the event loop keeps running and hits show up as they are found. Lines
+// that arrive after Start() are not searched.
+class SearchJob {
+public:
+    static const unsigned long kMaxHits = 500;
+
+    SearchJob();
+
+    void Start(std::string_view text, bool useIndex = true);
+    // 'logName' is empty for a window that is not logged. Flush its log
+    // first: where it ends is noted here, and Step() walks back from there
+    // over the scrollback's lines before searching what came earlier.
+    int AddSource(Scrollback* scrollback, std::string_view logDirectory, std::string_view logName);
+    // Stops using a scrollback that is about to be deleted
+    void RemoveSource(Scrollback* scrollback);
+
+    bool Running() const { return running; }
+    // Appends new hits; false once the search is over
+    bool Step(uint32_t budgetMicros, std::vector<SearchHit>& hits);
+    void Cancel() { running = false; }
+
+    std::string_view Text() const { return text; }
+    const SearchStats& GetStats() const { return stats; }
+
+private:
+    struct Source {
+        Scrollback* scrollback;
+        std::string logDirectory;
+        std::string logName;
+        uint32_t nextLine;    // scrollback position
+        uint32_t endLine;     // EndLine() when added
+        bool hasLog;
+        HistoryPos logEnd;    // where the scrollback begins in the log...
+        uint32_t logSkip;     // ...once this many lines are walked back over
+    };
+
+    std::string text;
+    SearchPattern pattern;
+    bool useIndex;
+    bool running;
+    std::vector<Source> sources;
+    size_t current;
+    bool inLog;               // scanning the current source's history
+    HistoryReader history;
+    HistoryPos logPos;
+    HistoryPos logEnd;
+    SearchStats stats;
+
+    void AddHit(std::vector<SearchHit>& hits, bool fromLog, const char* line, size_t length);
+    bool ScanChunk(Source& source, std::vector<SearchHit>& hits);
+    void NextSource();
+
+    SearchJob(const SearchJob&);
+    SearchJob& operator=(const SearchJob&);
+};
+
+#endif // SEARCH_H
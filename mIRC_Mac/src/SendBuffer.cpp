@@ -0,0 +1,45 @@
+#include "SendBuffer.h"
+#include <cstring>
+
+SendBuffer::SendBuffer(size_t capacity)
+    : data(new char[capacity]), capacity(capacity), readPos(0), writePos(0) {
+}
+
+SendBuffer::~SendBuffer() {
+    delete[] data;
+}
+
+char* SendBuffer::Reserve(size_t length) {
+    if (length > Free()) return nullptr;
+
+    // Slide the unsent tail down rather than wrapping; it is almost always
+    // a few bytes at most.
+    if (writePos + length > capacity) {
+        memmove(data, data + readPos, Size());
+        writePos -= readPos;
+        readPos = 0;
+    }
+    return data + writePos;
+}
+
+bool SendBuffer::AppendLine(std::initializer_list<std::string_view> pieces) {
+    size_t length = 2;
+    for (std::string_view piece : pieces) length += piece.size();
+
+    char* dst = Reserve(length);
+    if (!dst) return false;
+
+    for (std::string_view piece : pieces) {
+        memcpy(dst, piece.data(), piece.size());
+        dst += piece.size();
+    }
+    dst[0] = '\r';
+    dst[1] = '\n';
+    Commit(length);
+    return true;
+}
+
+void SendBuffer::Consume(size_t bytes) {
+    readPos += bytes;
+    if (readPos >= writePos) readPos = writePos = 0;
+}
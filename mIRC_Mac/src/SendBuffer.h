@@ -0,0 +1,44 @@
+#ifndef SEND_BUFFER_H
+#define SEND_BUFFER_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <string_view>
+
+// Contiguous outbound byte queue. Commands are assembled in place from
+// their pieces (no temporary std::string per command) and the whole
+// backlog is handed to send() in one call. A short write just consumes
+// what was accepted; the rest goes out on the next flush.
+class SendBuffer {
+public:
+    explicit SendBuffer(size_t capacity);
+    ~SendBuffer();
+
+    // Appends the concatenated pieces plus CRLF. Returns false, leaving the
+    // buffer untouched, if the line does not fit.
+    bool AppendLine(std::initializer_list<std::string_view> pieces);
+
+    // Contiguous space for 'length' bytes at the end of the queue (or null
+    // if it does not fit). Finish with Commit() of at most that many bytes.
+    char* Reserve(size_t length);
+    void Commit(size_t length) { writePos += length; }
+
+    const char* Data() const { return data + readPos; }
+    size_t Size() const { return writePos - readPos; }
+    size_t Free() const { return capacity - Size(); }
+    bool Empty() const { return readPos == writePos; }
+
+    void Consume(size_t bytes);
+    void Clear() { readPos = writePos = 0; }
+
+private:
+    char* data;
+    size_t capacity;
+    size_t readPos;
+    size_t writePos;
+
+    SendBuffer(const SendBuffer&);
+    SendBuffer& operator=(const SendBuffer&);
+};
+
+#endif // SEND_BUFFER_H
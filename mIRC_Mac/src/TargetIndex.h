@@ -0,0 +1,105 @@
+#ifndef TARGET_INDEX_H
+#define TARGET_INDEX_H
+
+#include "CaseMap.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Open-addressed hash from a case-folded IRC target (channel or nick) to
+// the object that owns it. Keys are views of a string inside the value,
+// so the value must outlive its entry. Linear probing with backward-shift
+// deletion keeps lookups O(1) without tombstones.
+template <class T>
+class TargetIndex {
+public:
+    TargetIndex() : count(0), mapping(CaseMapping::Rfc1459) {
+        slots.resize(kInitialSlots);
+    }
+
+    CaseMapping Mapping() const { return mapping; }
+    size_t Size() const { return count; }
+    size_t MemoryBytes() const { return slots.capacity() * sizeof(Slot); }
+
+    T* Find(std::string_view target) const {
+        size_t mask = slots.size() - 1;
+        uint32_t hash = IRCHash(target, mapping);
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (!slot.value) return nullptr;
+            if (slot.hash == hash && IRCEquals(slot.key, target, mapping)) return slot.value;
+        }
+    }
+
+    void Insert(std::string_view target, T* value) {
+        if ((count + 1) * 2 > slots.size()) Resize(slots.size() * 2);
+        Place(target, IRCHash(target, mapping), value);
+        count++;
+    }
+
+    // Removes the entry for 'value', found by identity: after SetMapping()
+    // two values may share a folded name, and only this one may go
+    void Remove(std::string_view target, const T* value) {
+        size_t mask = slots.size() - 1;
+        uint32_t hash = IRCHash(target, mapping);
+        size_t i = hash & mask;
+        for (;; i = (i + 1) & mask) {
+            if (!slots[i].value) return;
+            if (slots[i].value == value) break;
+        }
+
+        // Pull later members of the probe run back over the hole
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; slots[j].value; j = (j + 1) & mask) {
+            size_t home = slots[j].hash & mask;
+            bool movable = (hole <= j) ? (home <= hole || home > j) : (home <= hole && home > j);
+            if (movable) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot();
+        count--;
+    }
+
+    // The server announced a different CASEMAPPING: rehash everything
+    void SetMapping(CaseMapping newMapping) {
+        if (newMapping == mapping) return;
+        mapping = newMapping;
+        Resize(slots.size());
+    }
+
+private:
+    static const size_t kInitialSlots = 64;
+
+    struct Slot {
+        Slot() : hash(0), value(nullptr) {}
+        std::string_view key;
+        uint32_t hash;
+        T* value;
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+    CaseMapping mapping;
+
+    void Place(std::string_view target, uint32_t hash, T* value) {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].value) i = (i + 1) & mask;
+        slots[i].key = target;
+        slots[i].hash = hash;
+        slots[i].value = value;
+    }
+
+    void Resize(size_t size) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(size);
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].value) Place(old[i].key, IRCHash(old[i].key, mapping), old[i].value);
+        }
+    }
+};
+
+#endif // TARGET_INDEX_H
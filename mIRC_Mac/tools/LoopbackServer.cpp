@@ -0,0 +1,498 @@
+// Scriptable IRC server on 127.0.0.1 that drives a real IRCClient over the
+// POSIX socket path (built without LOCAL_TESTING). Server and client share
+// one loop and one clock, so latencies are measured end to end:
+//
+//   pong_turnaround     server PING written -> matching PONG read
+//   message_to_callback server PRIVMSG written -> OnIRCMessage called
+//   input_to_wire       PrivMsg() called -> line read by the server
+//
+//   ./mIRC_Loopback [--verbose] [script]
+//
+// Script lines (# starts a comment):
+//   send <raw line>                  server sends one line
+//   burst <count> <lines/sec> <line> server sends 'count' lines, 0 = unpaced
+//   ping <count> <interval-ms>       server PINGs, client should PONG
+//   say <count> <interval-ms> <target>  client sends PRIVMSGs
+//   sleep <ms>
+//   flood off|throttle|drop <lines> <window-ms>
+//                                    server-side flood policy for our lines
+//   clientflood <burst> <ms-per-line>  the client's own OutboundQueue
+// In sent lines $n is the sequence number and $ts a timestamp that the
+// measuring side recognises. Results are JSON lines on stdout.
+
+#include "../src/IRCClient.h"
+#include "../src/IRCParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// PONGs spend the client's flood credit too, so loosen it up front
+static const char* kDefaultScript =
+    "clientflood 10 50\n"
+    "send :irc.example.net 375 benchnick :- Message of the Day -\n"
+    "burst 200 0 :irc.example.net 372 benchnick :- line $n\n"
+    "send :irc.example.net 376 benchnick :End of /MOTD command.\n"
+    "send :benchnick!b@localhost JOIN #loopback\n"
+    "ping 20 50\n"
+    "burst 2000 20000 :peer$n!p@localhost PRIVMSG #loopback :$ts hello from the loopback\n"
+    "burst 5000 0 :peer$n!p@localhost PRIVMSG #loopback :$ts unpaced burst\n"
+    "say 30 100 #loopback\n"
+    "flood throttle 10 1000\n"
+    "clientflood 50 10\n"
+    "say 40 0 #loopback\n"
+    "sleep 500\n";
+
+// How long to wait for stragglers (PONGs, queued PRIVMSGs) after the script
+static const uint64_t kDrainNanos = 5000000000ull;
+static const uint64_t kSettleNanos = 200000000ull;
+static const size_t kMaxServerLine = 8192;
+
+static uint64_t NowNanos() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Timestamps travel as "ts=<ns>" anywhere in the text
+static bool FindStamp(std::string_view text, uint64_t& stamp) {
+    size_t at = text.find("ts=");
+    if (at == std::string_view::npos) return false;
+    stamp = std::strtoull(std::string(text.substr(at + 3, 20)).c_str(), nullptr, 10);
+    return stamp != 0;
+}
+
+struct Samples {
+    std::vector<double> micros;
+
+    void Add(uint64_t start, uint64_t end) { micros.push_back((end - start) / 1000.0); }
+
+    void Print(const char* name) {
+        if (micros.empty()) {
+            std::printf("{\"metric\":\"%s\",\"count\":0}\n", name);
+            return;
+        }
+        std::sort(micros.begin(), micros.end());
+        size_t n = micros.size();
+        std::printf("{\"metric\":\"%s\",\"count\":%zu,\"p50_us\":%.1f,\"p90_us\":%.1f,"
+                    "\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+                    name, n, micros[n / 2], micros[n * 9 / 10], micros[n * 99 / 100], micros[n - 1]);
+    }
+};
+
+// Client side: stamps PRIVMSGs as they come out of IRCClient
+struct TimingSink {
+    bool verbose;
+    unsigned long messages;
+    Samples messageToCallback;
+
+    explicit TimingSink(bool verbose) : verbose(verbose), messages(0) {}
+
+    void OnIRCLog(std::string_view s) {
+        if (verbose) std::fprintf(stderr, "%.*s\n", (int)s.size(), s.data());
+    }
+    void OnIRCMessage(IRCTarget, std::string_view, std::string_view text, const IRCTags&) {
+        uint64_t stamp;
+        messages++;
+        if (FindStamp(text, stamp)) messageToCallback.Add(stamp, NowNanos());
+    }
+    void OnIRCJoin(IRCTarget, std::string_view, bool) {}
+    void OnIRCPart(IRCTarget, std::string_view, std::string_view, bool) {}
+    void OnIRCQuit(IRCTarget, std::string_view, std::string_view) {}
+    void OnIRCNick(IRCTarget, std::string_view, std::string_view, bool) {}
+    void OnIRCNames(IRCTarget) {}
+    void OnIRCBatchStart(std::string_view, IRCTarget) {}
+    void OnIRCBatchEnd(std::string_view, IRCTarget) {}
+    void OnIRCNetsplit(IRCTarget, std::string_view, uint32_t, bool) {}
+};
+
+class LoopbackServer {
+public:
+    enum FloodPolicy { kFloodOff, kFloodThrottle, kFloodDrop };
+
+    LoopbackServer() : listenFD(-1), clientFD(-1), registered(false), seq(0),
+                       floodPolicy(kFloodOff), floodNanosPerLine(0), floodWindow(0),
+                       floodClock(0), throttledSince(0), throttledNanos(0), drops(0) {}
+
+    ~LoopbackServer() {
+        if (clientFD != -1) close(clientFD);
+        if (listenFD != -1) close(listenFD);
+    }
+
+    // Binds an ephemeral port; returns it, or 0 on failure
+    int Listen() {
+        listenFD = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFD < 0) return 0;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFD, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFD, 1) < 0) return 0;
+        socklen_t len = sizeof(addr);
+        getsockname(listenFD, (struct sockaddr*)&addr, &len);
+        return ntohs(addr.sin_port);
+    }
+
+    bool Registered() const { return registered; }
+    bool Connected() const { return clientFD != -1; }
+    bool Backlogged() { return Throttled() || inbox.find('\n') != std::string::npos; }
+    unsigned long Drops() const { return drops; }
+    double ThrottledMillis() const { return throttledNanos / 1e6; }
+
+    void SetFlood(FloodPolicy policy, unsigned lines, uint32_t windowMillis) {
+        floodPolicy = policy;
+        floodWindow = (uint64_t)windowMillis * 1000000;
+        floodNanosPerLine = lines ? floodWindow / lines : 0;
+        floodClock = 0;
+    }
+
+    // Expands $n and $ts and writes the line. Blocking, like a real
+    // server's send queue from our point of view.
+    void Send(const std::string& line) {
+        if (clientFD == -1) return;
+        std::string out;
+        seq++;
+        for (size_t i = 0; i < line.size(); i++) {
+            if (line.compare(i, 3, "$ts") == 0) {
+                out += "ts=" + std::to_string(NowNanos());
+                i += 2;
+            } else if (line.compare(i, 2, "$n") == 0) {
+                out += std::to_string(seq);
+                i += 1;
+            } else {
+                out += line[i];
+            }
+        }
+        out += "\r\n";
+        WriteAll(out);
+    }
+
+    // Waits up to 'timeoutMillis' for the client and handles what it sent
+    void Poll(int timeoutMillis) {
+        struct pollfd pfd;
+        pfd.fd = (clientFD != -1) ? clientFD : listenFD;
+        pfd.events = POLLIN;
+        if (Throttled()) pfd.fd = -1; // leave it in the kernel, like a server that stopped reading us
+        if (poll(&pfd, 1, timeoutMillis) > 0) {
+            if (clientFD == -1) {
+                clientFD = accept(listenFD, nullptr, nullptr);
+            } else {
+                char buf[4096];
+                ssize_t n = recv(clientFD, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    Drop(nullptr);
+                } else {
+                    inbox.append(buf, n);
+                }
+            }
+        }
+        ProcessInbox();
+    }
+
+    Samples pong;
+    Samples inputToWire;
+
+private:
+    int listenFD;
+    int clientFD;
+    bool registered;
+    unsigned long seq;
+    std::string inbox;
+    std::string nick;
+
+    FloodPolicy floodPolicy;
+    uint64_t floodNanosPerLine;
+    uint64_t floodWindow;
+    uint64_t floodClock;     // ircd-style: each line pushes this forward
+    uint64_t throttledSince;
+    uint64_t throttledNanos;
+    unsigned long drops;
+
+    bool Throttled() {
+        if (floodPolicy != kFloodThrottle) return false;
+        uint64_t now = NowNanos();
+        bool throttled = floodClock > now + floodWindow;
+        if (throttled && !throttledSince) throttledSince = now;
+        if (!throttled && throttledSince) {
+            throttledNanos += now - throttledSince;
+            throttledSince = 0;
+        }
+        return throttled;
+    }
+
+    void WriteAll(const std::string& data) {
+        size_t done = 0;
+        while (done < data.size() && clientFD != -1) {
+            ssize_t n = send(clientFD, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+            if (n > 0) {
+                done += n;
+            } else if (n < 0 && errno == EAGAIN) {
+                poll(nullptr, 0, 1);
+            } else {
+                Drop(nullptr);
+            }
+        }
+    }
+
+    void Drop(const char* reason) {
+        if (clientFD == -1) return;
+        if (reason) {
+            WriteAll(std::string("ERROR :Closing Link: (") + reason + ")\r\n");
+            drops++;
+        }
+        close(clientFD);
+        clientFD = -1;
+    }
+
+    void ProcessInbox() {
+        size_t start = 0;
+        for (;;) {
+            if (Throttled()) break;
+            size_t eol = inbox.find('\n', start);
+            if (eol == std::string::npos) break;
+            size_t len = eol - start;
+            if (len && inbox[start + len - 1] == '\r') len--;
+            if (len > kMaxServerLine) len = kMaxServerLine;
+            HandleLine(inbox.data() + start, len);
+            start = eol + 1;
+            if (clientFD == -1) {
+                inbox.clear();
+                return;
+            }
+        }
+        inbox.erase(0, start);
+    }
+
+    void HandleLine(const char* line, size_t len) {
+        uint64_t now = NowNanos();
+        IRCMessageView msg;
+        if (!ParseIRCLine(line, len, msg)) return;
+
+        if (floodPolicy != kFloodOff && floodNanosPerLine) {
+            floodClock = std::max(floodClock, now) + floodNanosPerLine;
+            if (floodPolicy == kFloodDrop && floodClock > now + floodWindow) {
+                Drop("Excess Flood");
+                return;
+            }
+        }
+
+        uint64_t stamp;
+        switch (msg.commandId) {
+            case IRCCommand::Nick:
+                if (msg.paramCount > 0) nick = std::string(msg.Param(0));
+                break;
+            case IRCCommand::Pong:
+                if (msg.paramCount > 0 && FindStamp(msg.Param(msg.paramCount - 1), stamp)) pong.Add(stamp, now);
+                break;
+            case IRCCommand::Privmsg:
+                if (msg.paramCount > 1 && FindStamp(msg.Param(1), stamp)) inputToWire.Add(stamp, now);
+                break;
+            default:
+                if (msg.Command() == "USER" && !registered && !nick.empty()) {
+                    registered = true;
+                    Send(":irc.example.net 001 " + nick + " :Welcome to the loopback network");
+                }
+                break;
+        }
+    }
+
+    LoopbackServer(const LoopbackServer&);
+    LoopbackServer& operator=(const LoopbackServer&);
+};
+
+struct Step {
+    std::string op;
+    long count;
+    double rate;     // lines/sec for burst, interval in ms otherwise
+    std::string text;
+};
+
+static bool ParseScript(const std::string& script, std::vector<Step>& steps) {
+    std::istringstream in(script);
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        std::istringstream words(line.substr(first));
+        Step step = { "", 1, 0, "" };
+        words >> step.op;
+        if (step.op == "send") {
+        } else if (step.op == "burst" || step.op == "ping" || step.op == "say" || step.op == "clientflood") {
+            words >> step.count >> step.rate;
+        } else if (step.op == "sleep") {
+            words >> step.rate;
+        } else if (step.op == "flood") {
+            std::string policy;
+            words >> policy >> step.count >> step.rate;
+            step.text = policy;
+        } else {
+            std::fprintf(stderr, "script line %d: unknown command '%s'\n", lineNo, step.op.c_str());
+            return false;
+        }
+        if (words.fail()) {
+            std::fprintf(stderr, "script line %d: bad arguments\n", lineNo);
+            return false;
+        }
+        if (step.op != "flood") {
+            std::getline(words, step.text);
+            size_t start = step.text.find_first_not_of(' ');
+            step.text = (start == std::string::npos) ? "" : step.text.substr(start);
+        }
+        steps.push_back(step);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    std::string script = kDefaultScript;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--verbose")) {
+            verbose = true;
+        } else {
+            std::ifstream in(argv[i]);
+            if (!in) {
+                std::fprintf(stderr, "cannot read script %s\n", argv[i]);
+                return 2;
+            }
+            std::stringstream ss;
+            ss << in.rdbuf();
+            script = ss.str();
+        }
+    }
+
+    std::vector<Step> steps;
+    if (!ParseScript(script, steps)) return 2;
+
+    LoopbackServer server;
+    int port = server.Listen();
+    if (!port) {
+        std::perror("listen");
+        return 2;
+    }
+
+    TimingSink sink(verbose);
+    IRCClient client;
+    client.Connect("127.0.0.1", port, "benchnick", "bench", "Loopback test");
+
+    // Registration
+    uint64_t deadline = NowNanos() + kDrainNanos;
+    while (client.GetState() != IRCClient::State::Connected && NowNanos() < deadline) {
+        client.Update(sink);
+        server.Poll(1);
+    }
+    if (client.GetState() != IRCClient::State::Connected) {
+        std::fprintf(stderr, "client did not register\n");
+        return 1;
+    }
+
+    uint64_t scriptStart = NowNanos();
+    uint64_t burstLines = 0, burstNanos = 0;
+    size_t index = 0;
+    long done = 0;
+    uint64_t nextAt = 0;
+    uint64_t stepStart = 0;
+
+    while (index < steps.size() && server.Connected()) {
+        const Step& step = steps[index];
+        uint64_t now = NowNanos();
+        bool finished = false;
+
+        if (done == 0 && stepStart == 0) stepStart = now;
+
+        if (now >= nextAt) {
+            if (step.op == "send") {
+                server.Send(step.text);
+                finished = true;
+            } else if (step.op == "burst") {
+                server.Send(step.text);
+                done++;
+                if (step.rate > 0) nextAt = stepStart + (uint64_t)(done * 1e9 / step.rate);
+                if (done >= step.count) {
+                    burstLines += step.count;
+                    burstNanos += NowNanos() - stepStart;
+                    finished = true;
+                }
+            } else if (step.op == "ping") {
+                server.Send("PING :$ts");
+                done++;
+                nextAt = now + (uint64_t)(step.rate * 1e6);
+                finished = done >= step.count;
+            } else if (step.op == "say") {
+                std::string text = "ts=" + std::to_string(NowNanos()) + " typed line";
+                client.PrivMsg(step.text, text);
+                done++;
+                nextAt = now + (uint64_t)(step.rate * 1e6);
+                finished = done >= step.count;
+            } else if (step.op == "sleep") {
+                if (done == 0) {
+                    nextAt = now + (uint64_t)(step.rate * 1e6);
+                    done = 1;
+                } else {
+                    finished = true;
+                }
+            } else if (step.op == "flood") {
+                LoopbackServer::FloodPolicy policy = LoopbackServer::kFloodOff;
+                if (step.text == "throttle") policy = LoopbackServer::kFloodThrottle;
+                else if (step.text == "drop") policy = LoopbackServer::kFloodDrop;
+                server.SetFlood(policy, (unsigned)step.count, (uint32_t)step.rate);
+                finished = true;
+            } else if (step.op == "clientflood") {
+                OutboundQueue::FloodControl control = { (unsigned)step.count, (uint32_t)step.rate, 0 };
+                client.SetFloodControl(control);
+                finished = true;
+            }
+        }
+
+        if (finished) {
+            index++;
+            done = 0;
+            nextAt = 0;
+            stepStart = 0;
+        }
+
+        // Sleep only when nothing is due; an unpaced burst never waits
+        client.Update(sink);
+        bool due = finished || NowNanos() >= nextAt;
+        server.Poll(due ? 0 : 1);
+    }
+
+    // Let queued output and in-flight replies land
+    uint64_t drainStart = NowNanos();
+    while (server.Connected()) {
+        uint64_t elapsed = NowNanos() - drainStart;
+        if (elapsed >= kDrainNanos) break;
+        if (elapsed >= kSettleNanos && !client.HasQueuedOutput() && !client.HasPendingInput() &&
+            !server.Backlogged()) break;
+        client.Update(sink);
+        server.Poll(1);
+    }
+    double scriptSecs = (NowNanos() - scriptStart) / 1e9;
+
+    server.pong.Print("pong_turnaround");
+    sink.messageToCallback.Print("message_to_callback");
+    server.inputToWire.Print("input_to_wire");
+
+    const IRCClient::SendStats& sent = client.GetSendStats();
+    std::printf("{\"metric\":\"session\",\"seconds\":%.3f,\"messages\":%lu,\"burst_lines_per_sec\":%.0f,"
+                "\"write_calls\":%lu,\"partial_writes\":%lu,\"throttled_ms\":%.1f,\"dropped\":%s}\n",
+                scriptSecs, sink.messages, burstNanos ? burstLines * 1e9 / burstNanos : 0.0,
+                sent.writeCalls, sent.partialWrites, server.ThrottledMillis(),
+                server.Drops() ? "true" : "false");
+    return 0;
+}